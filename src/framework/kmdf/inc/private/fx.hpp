@@ -196,6 +196,7 @@ extern "C" {
 #include "FxUsbPipe.hpp"
 
 // DMA support
+#include "FxCommonBufferPool.hpp"
 #include "FxDmaEnabler.hpp"
 #include "FxDmaTransaction.hpp"
 #include "FxCommonBuffer.hpp"
@@ -156,6 +156,14 @@ protected:
     //
     size_t               m_Alignment;
 
+    //
+    // Slab and block index the buffer was carved from when it was allocated
+    // from the enabler's common buffer pool, NULL if it owns its allocation.
+    //
+    FxCommonBufferSlab  * m_Slab;
+
+    ULONG                 m_SlabBlock;
+
 };
 
 #endif // _FXCOMMONBUFFER_H_
@@ -0,0 +1,157 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+    FxCommonBufferPool.hpp
+
+Abstract:
+
+    Sub-allocator which carves small common buffers out of larger common
+    buffer slabs allocated from a DMA enabler.
+
+Environment:
+
+    Kernel mode only.
+
+Notes:
+
+    Blocks are power of two sized and a slab is page aligned in both its
+    virtual and logical address, so every block is naturally aligned to its
+    own size in both address spaces and never crosses a page boundary.
+
+Revision History:
+
+--*/
+
+#ifndef _FXCOMMONBUFFERPOOL_H_
+#define _FXCOMMONBUFFERPOOL_H_
+
+//
+// Smallest and largest block handed out by the pool.  Larger requests, or
+// requests whose alignment exceeds the largest block, get their own common
+// buffer.
+//
+#define FX_COMMON_BUFFER_POOL_MIN_BLOCK     (64)
+#define FX_COMMON_BUFFER_POOL_MAX_BLOCK     (1024)
+#define FX_COMMON_BUFFER_POOL_CLASSES       (5)
+
+//
+// Size of each slab allocated from the enabler
+//
+#define FX_COMMON_BUFFER_POOL_SLAB_SIZE     (4 * PAGE_SIZE)
+
+#define FX_COMMON_BUFFER_POOL_NO_BLOCK      ((ULONG) -1)
+
+class FxDmaEnabler;
+
+struct FxCommonBufferSlab {
+    //
+    // Entry in the owning class's partial or full slab list
+    //
+    LIST_ENTRY ListEntry;
+
+    PVOID BufferVA;
+
+    PHYSICAL_ADDRESS BufferLA;
+
+    ULONG Class;
+
+    ULONG BlockSize;
+
+    ULONG BlockCount;
+
+    ULONG FreeCount;
+
+    //
+    // Index of the first free block, FX_COMMON_BUFFER_POOL_NO_BLOCK if none.
+    // NextFree[i] links free block i to the next free block.
+    //
+    ULONG FreeHead;
+
+    ULONG NextFree[1];
+};
+
+struct FxCommonBufferPoolClass {
+    //
+    // Slabs with at least one free block, allocation always uses the head
+    //
+    LIST_ENTRY PartialSlabs;
+
+    //
+    // Slabs with no free blocks
+    //
+    LIST_ENTRY FullSlabs;
+};
+
+class FxCommonBufferPool {
+
+public:
+
+    FxCommonBufferPool(
+        VOID
+        );
+
+    VOID
+    Initialize(
+        __in FxDmaEnabler* DmaEnabler
+        );
+
+    static
+    BOOLEAN
+    CanAllocate(
+        __in size_t Length,
+        __in size_t Alignment
+        )
+    {
+        return (Length <= FX_COMMON_BUFFER_POOL_MAX_BLOCK &&
+                Alignment < FX_COMMON_BUFFER_POOL_MAX_BLOCK) ? TRUE : FALSE;
+    }
+
+    _Must_inspect_result_
+    NTSTATUS
+    Allocate(
+        __in size_t Length,
+        __in size_t Alignment,
+        __deref_out FxCommonBufferSlab** Slab,
+        __out PULONG Block,
+        __deref_out PVOID* BufferVA,
+        __out PHYSICAL_ADDRESS* BufferLA
+        );
+
+    VOID
+    Free(
+        __in FxCommonBufferSlab* Slab,
+        __in ULONG Block
+        );
+
+    VOID
+    Destroy(
+        VOID
+        );
+
+protected:
+
+    _Must_inspect_result_
+    FxCommonBufferSlab*
+    AllocateSlab(
+        __in ULONG Class
+        );
+
+    VOID
+    FreeSlab(
+        __in FxCommonBufferSlab* Slab
+        );
+
+    FxDmaEnabler* m_DmaEnabler;
+
+    //
+    // Guards the slab lists and the free lists of every slab
+    //
+    MxLock m_Lock;
+
+    FxCommonBufferPoolClass m_Classes[FX_COMMON_BUFFER_POOL_CLASSES];
+};
+
+#endif // _FXCOMMONBUFFERPOOL_H_
@@ -54,6 +54,10 @@ FxDeviceDescriptionEntry::FxDeviceDescriptionEntry(
     InitializeListHead(&m_DescriptionLink);
     InitializeListHead(&m_ModificationLink);
 
+    InitializeListHead(&m_IdHashLink[DescriptionIndex]);
+    InitializeListHead(&m_IdHashLink[ModificationIndex]);
+    m_IdHash = 0;
+
     m_ModificationState = ModificationInsert;
 
     m_DeviceList = DeviceList;
@@ -179,7 +183,7 @@ FxDeviceDescriptionEntry::IsDeviceRemoved(
             //
             // Remove from the current list
             //
-            RemoveEntryList(&m_DescriptionLink);
+            pList->RemoveDescriptionLocked(this);
             InitializeListHead(&m_DescriptionLink);
         }
         else {
@@ -232,7 +236,7 @@ FxDeviceDescriptionEntry::ProcessDeviceRemoved(
     // to iterate thru the child list.
     //
     if (pList->GetScanCount() == 0 || IsListEmpty(&m_DescriptionLink)) {
-        RemoveEntryList(&m_DescriptionLink);
+        pList->RemoveDescriptionLocked(this);
 
         //
         // Instead of reimplementing a single description cleanup, just use the
@@ -330,6 +334,16 @@ FxChildList::FxChildList(
     InitializeListHead(&m_DescriptionListHead);
     InitializeListHead(&m_ModificationListHead);
 
+    RtlZeroMemory(m_IdIndex, sizeof(m_IdIndex));
+    m_IndexIds = FALSE;
+
+    m_RelationsGeneration = 0;
+    m_RelationsSnapshot = NULL;
+    m_RelationsSnapshotCount = 0;
+    m_RelationsSnapshotCapacity = 0;
+    m_RelationsSnapshotGeneration = 0;
+    m_RelationsSnapshotValid = FALSE;
+
     m_State = ListUnlocked;
 
     m_InvalidationNeeded = FALSE;
@@ -348,6 +362,29 @@ FxChildList::FxChildList(
     
     MarkDisposeOverride(ObjectDoNotLock);
 }
+
+FxChildList::~FxChildList(
+    VOID
+    )
+{
+    ULONG i;
+
+    //
+    // Every description holds a reference on the list, so no entry can still
+    // be linked into an index at this point.
+    //
+    for (i = 0; i < ARRAYSIZE(m_IdIndex); i++) {
+        if (m_IdIndex[i].Buckets != NULL) {
+            FxPoolFree(m_IdIndex[i].Buckets);
+            m_IdIndex[i].Buckets = NULL;
+        }
+    }
+
+    if (m_RelationsSnapshot != NULL) {
+        FxPoolFree(m_RelationsSnapshot);
+        m_RelationsSnapshot = NULL;
+    }
+}
     
 BOOLEAN
 FxChildList::Dispose(
@@ -434,6 +471,12 @@ FxChildList::Initialize(
     m_EvtIdentificationDescriptionCleanup = Config->EvtChildListIdentificationDescriptionCleanup;
     m_EvtIdentificationDescriptionCompare = Config->EvtChildListIdentificationDescriptionCompare;
 
+    //
+    // A driver supplied compare routine can treat descriptions with different
+    // bytes as equal, so they can only be hashed when compared bytewise.
+    //
+    m_IndexIds = (m_EvtIdentificationDescriptionCompare == NULL) ? TRUE : FALSE;
+
     m_EvtAddressDescriptionDuplicate = Config->EvtChildListAddressDescriptionDuplicate;
     m_EvtAddressDescriptionCopy = Config->EvtChildListAddressDescriptionCopy;
     m_EvtAddressDescriptionCleanup = Config->EvtChildListAddressDescriptionCleanup;
@@ -689,7 +732,7 @@ FxChildList::EndScan(
                     // will be re-added below when we iterate over the
                     // descriptions list.
                     //
-                    RemoveEntryList(&pEntry->m_ModificationLink);
+                    RemoveModificationLocked(pEntry);
                     InitializeListHead(&pEntry->m_ModificationLink);
 
                     //
@@ -723,7 +766,7 @@ FxChildList::EndScan(
                 // Update the current pointer before the entry is removed.
                 pCur = pCur->Blink;
 
-                RemoveEntryList(&pEntry->m_DescriptionLink);
+                RemoveDescriptionLocked(pEntry);
                 InsertTailList(&freeHead, &pEntry->m_DescriptionLink);
                 pEntry = NULL;
                 continue;
@@ -1367,7 +1410,7 @@ FxChildList::ReenumerateEntryLocked(
             // clone it and insert a modification.
             //
             Entry->m_ModificationState = ModificationClone;
-            InsertTailList(&m_ModificationListHead, &Entry->m_ModificationLink);
+            InsertModificationLocked(Entry);
         }
 
         DoTraceLevelMessage(
@@ -1610,8 +1653,7 @@ FxChildList::Add(
 
             if (NT_SUCCESS(status)) {
                 pEntry->m_FoundInLastScan = TRUE;
-                InsertTailList(&m_ModificationListHead,
-                               &pEntry->m_ModificationLink);
+                InsertModificationLocked(pEntry);
 
                 if (m_StaticList) {
                     FxDevice* pPdo;
@@ -1730,8 +1772,7 @@ FxChildList::CloneEntryLocked(
             // clone before the old device.  Since all changes search the
             // list backwards, inserting at the tail accomplishes this.
             //
-            InsertTailList(&m_DescriptionListHead,
-                           &pClone->m_DescriptionLink);
+            InsertDescriptionLocked(pClone);
 
             if (FromQDR == FALSE) {
                 Entry->m_DescriptionState = DescriptionNotPresent;
@@ -1819,10 +1860,11 @@ FxChildList::ProcessModificationsLocked(
 
     invalidateRelations = FALSE;
     while(!IsListEmpty(&m_ModificationListHead)) {
-        pCur = RemoveHeadList(&m_ModificationListHead);
+        pEntry = FxDeviceDescriptionEntry::_FromModificationLink(
+            m_ModificationListHead.Flink);
 
-        InitializeListHead(pCur);
-        pEntry = FxDeviceDescriptionEntry::_FromModificationLink(pCur);
+        RemoveModificationLocked(pEntry);
+        InitializeListHead(&pEntry->m_ModificationLink);
 
         ASSERT(pEntry->m_ModificationState == ModificationInsert ||
                   pEntry->m_ModificationState == ModificationClone ||
@@ -1863,7 +1905,7 @@ FxChildList::ProcessModificationsLocked(
                     GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGPNP,
                     "entry %p never reported to pnp, mark for deletion", pEntry);
 
-                RemoveEntryList(&pEntry->m_DescriptionLink);
+                RemoveDescriptionLocked(pEntry);
                 InsertTailList(FreeListHead, &pEntry->m_DescriptionLink);
                 break;
 
@@ -1896,7 +1938,7 @@ FxChildList::ProcessModificationsLocked(
                 GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGPNP,
                 "marking entry %p as needing instantiation", pEntry);
 
-            InsertTailList(&m_DescriptionListHead, &pEntry->m_DescriptionLink);
+            InsertDescriptionLocked(pEntry);
             pEntry->m_ModificationState = ModificationUnspecified;
             invalidateRelations = TRUE;
             break;
@@ -1914,6 +1956,8 @@ FxChildList::ProcessModificationsLocked(
     if (invalidateRelations) {
         PDEVICE_OBJECT pdo;
 
+        m_RelationsGeneration++;
+
         if (m_ScanCount) {
             m_InvalidationNeeded = TRUE;
         }
@@ -1998,8 +2042,7 @@ Return Value:
         DescriptionEntry->m_ModificationState = ModificationRemoveNotify;
         DescriptionEntry->m_FoundInLastScan = FALSE;
 
-        InsertTailList(&m_ModificationListHead,
-                        &DescriptionEntry->m_ModificationLink);
+        InsertModificationLocked(DescriptionEntry);
     }
 }
 
@@ -2032,7 +2075,7 @@ Return Value:
         //
         // This one was never reported to the OS. Remove it now.
         //
-        RemoveEntryList(&ModificationEntry->m_ModificationLink);
+        RemoveModificationLocked(ModificationEntry);
         InitializeListHead(&ModificationEntry->m_ModificationLink);
 
         if (IsStaticList()) {
@@ -2063,7 +2106,7 @@ Return Value:
         // MarkDescriptionNotPresentWorker expects that m_ModificationEntry is
         // not in any list and points to itself.
         //
-        RemoveEntryList(&ModificationEntry->m_ModificationLink);
+        RemoveModificationLocked(ModificationEntry);
         InitializeListHead(&ModificationEntry->m_ModificationLink);
 
         MarkDescriptionNotPresentWorker(ModificationEntry, FALSE);
@@ -2159,6 +2202,258 @@ FxChildList::DrainFreeListHead(
     }
 }
 
+VOID
+FxChildList::InsertDescriptionLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    InsertTailList(&m_DescriptionListHead, &Entry->m_DescriptionLink);
+    IndexInsertLocked(Entry, DescriptionIndex);
+}
+
+VOID
+FxChildList::RemoveDescriptionLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+/*++
+
+Routine Description:
+    Removes the entry from the description list and its index.  The caller
+    is responsible for reinitializing or relinking m_DescriptionLink.  The
+    entry does not need to be in the list.
+
+  --*/
+{
+    RemoveEntryList(&Entry->m_DescriptionLink);
+    IndexRemoveLocked(Entry, DescriptionIndex);
+}
+
+VOID
+FxChildList::InsertModificationLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    InsertTailList(&m_ModificationListHead, &Entry->m_ModificationLink);
+    IndexInsertLocked(Entry, ModificationIndex);
+}
+
+VOID
+FxChildList::RemoveModificationLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+/*++
+
+Routine Description:
+    Removes the entry from the modification list and its index.  The caller
+    is responsible for reinitializing m_ModificationLink.
+
+  --*/
+{
+    RemoveEntryList(&Entry->m_ModificationLink);
+    IndexRemoveLocked(Entry, ModificationIndex);
+}
+
+ULONG
+FxChildList::HashId(
+    __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
+    )
+/*++
+
+Routine Description:
+    FNV-1a hash over the bytes CompareId compares when the driver did not
+    supply a compare routine.
+
+  --*/
+{
+    PUCHAR pBytes;
+    ULONG hash, i;
+
+    pBytes = (PUCHAR) Id;
+    hash = 2166136261;
+
+    for (i = 0; i < m_IdentificationDescriptionSize; i++) {
+        hash ^= pBytes[i];
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+VOID
+FxChildList::IndexInsertLocked(
+    __inout FxDeviceDescriptionEntry* Entry,
+    __in FxChildListIteratorIndexValues Index
+    )
+/*++
+
+Routine Description:
+    Adds an entry which was just inserted at the tail of the corresponding
+    list to the index.  The index is allocated on first use and doubled once
+    the average bucket holds more than two entries.
+
+  --*/
+{
+    FxChildListIdIndex* pIndex;
+
+    if (m_IndexIds == FALSE) {
+        return;
+    }
+
+    pIndex = &m_IdIndex[Index];
+
+    Entry->m_IdHash = HashId(Entry->m_IdentificationDescription);
+
+    if (pIndex->Buckets == NULL ||
+        (pIndex->Count >= 2 * pIndex->BucketCount &&
+         pIndex->BucketCount < FX_CHILD_LIST_ID_INDEX_MAX_BUCKETS)) {
+        //
+        // The rebuild picks up Entry from the list.  If it fails the old
+        // buckets, if any, are kept.
+        //
+        if (RebuildIndexLocked(Index) || pIndex->Buckets == NULL) {
+            return;
+        }
+    }
+
+    InsertHeadList(
+        &pIndex->Buckets[Entry->m_IdHash & (pIndex->BucketCount - 1)],
+        &Entry->m_IdHashLink[Index]);
+    pIndex->Count++;
+}
+
+VOID
+FxChildList::IndexRemoveLocked(
+    __inout FxDeviceDescriptionEntry* Entry,
+    __in FxChildListIteratorIndexValues Index
+    )
+{
+    if (IsListEmpty(&Entry->m_IdHashLink[Index])) {
+        //
+        // Not indexed
+        //
+        return;
+    }
+
+    RemoveEntryList(&Entry->m_IdHashLink[Index]);
+    InitializeListHead(&Entry->m_IdHashLink[Index]);
+
+    ASSERT(m_IdIndex[Index].Count > 0);
+    m_IdIndex[Index].Count--;
+}
+
+BOOLEAN
+FxChildList::RebuildIndexLocked(
+    __in FxChildListIteratorIndexValues Index
+    )
+/*++
+
+Routine Description:
+    Allocates a bucket array sized for the current list and rehashes every
+    entry of the list into it.  The list is walked from head to tail and each
+    entry is inserted at the head of its bucket, so buckets are ordered from
+    the most to the least recently inserted entry like a backwards search of
+    the list.
+
+Return Value:
+    TRUE if the index was rebuilt, FALSE if the bucket array could not be
+    allocated in which case the index is left untouched.
+
+  --*/
+{
+    FxChildListIdIndex* pIndex;
+    FxDeviceDescriptionEntry* pEntry;
+    PLIST_ENTRY pBuckets, pListHead, ple;
+    ULONG bucketCount, count, i;
+
+    pIndex = &m_IdIndex[Index];
+    pListHead = (Index == DescriptionIndex) ? &m_DescriptionListHead
+                                            : &m_ModificationListHead;
+
+    count = 0;
+    for (ple = pListHead->Flink; ple != pListHead; ple = ple->Flink) {
+        count++;
+    }
+
+    bucketCount = FX_CHILD_LIST_ID_INDEX_MIN_BUCKETS;
+    while (bucketCount < count &&
+           bucketCount < FX_CHILD_LIST_ID_INDEX_MAX_BUCKETS) {
+        bucketCount <<= 1;
+    }
+
+    pBuckets = (PLIST_ENTRY) FxPoolAllocate(GetDriverGlobals(),
+                                            NonPagedPool,
+                                            bucketCount * sizeof(LIST_ENTRY));
+    if (pBuckets == NULL) {
+        return FALSE;
+    }
+
+    for (i = 0; i < bucketCount; i++) {
+        InitializeListHead(&pBuckets[i]);
+    }
+
+    for (ple = pListHead->Flink; ple != pListHead; ple = ple->Flink) {
+        if (Index == DescriptionIndex) {
+            pEntry = FxDeviceDescriptionEntry::_FromDescriptionLink(ple);
+        }
+        else {
+            pEntry = FxDeviceDescriptionEntry::_FromModificationLink(ple);
+        }
+
+        InsertHeadList(&pBuckets[pEntry->m_IdHash & (bucketCount - 1)],
+                       &pEntry->m_IdHashLink[Index]);
+    }
+
+    if (pIndex->Buckets != NULL) {
+        FxPoolFree(pIndex->Buckets);
+    }
+
+    pIndex->Buckets = pBuckets;
+    pIndex->BucketCount = bucketCount;
+    pIndex->Count = count;
+
+    DoTraceLevelMessage(
+        GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGPNP,
+        "WDFCHILDLIST %p rebuilt %s index, %d entries in %d buckets",
+        GetHandle(), Index == DescriptionIndex ? "description" : "modification",
+        count, bucketCount);
+
+    return TRUE;
+}
+
+FxDeviceDescriptionEntry*
+FxChildList::IndexLookupLocked(
+    __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id,
+    __in FxChildListIteratorIndexValues Index
+    )
+/*++
+
+Routine Description:
+    Returns the most recently inserted entry of the list matching Id, the
+    same entry a backwards search of the list would find.
+
+  --*/
+{
+    FxChildListIdIndex* pIndex;
+    FxDeviceDescriptionEntry* pEntry;
+    PLIST_ENTRY pBucket, ple;
+    ULONG hash;
+
+    pIndex = &m_IdIndex[Index];
+    hash = HashId(Id);
+    pBucket = &pIndex->Buckets[hash & (pIndex->BucketCount - 1)];
+
+    for (ple = pBucket->Flink; ple != pBucket; ple = ple->Flink) {
+        pEntry = FxDeviceDescriptionEntry::_FromIdHashLink(ple, Index);
+
+        if (pEntry->m_IdHash == hash &&
+            CompareId(pEntry->m_IdentificationDescription, Id)) {
+            return pEntry;
+        }
+    }
+
+    return NULL;
+}
+
 FxDeviceDescriptionEntry*
 FxChildList::SearchBackwardsForMatchingModificationLocked(
     __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
@@ -2167,6 +2462,10 @@ FxChildList::SearchBackwardsForMatchingModificationLocked(
     PLIST_ENTRY ple;
     FxDeviceDescriptionEntry* pEntry;
 
+    if (m_IndexIds && m_IdIndex[ModificationIndex].Buckets != NULL) {
+        return IndexLookupLocked(Id, ModificationIndex);
+    }
+
     for (ple = m_ModificationListHead.Blink;
          ple != &m_ModificationListHead;
          ple = ple->Blink) {
@@ -2189,6 +2488,10 @@ FxChildList::SearchBackwardsForMatchingDescriptionLocked(
     PLIST_ENTRY ple;
     FxDeviceDescriptionEntry* pEntry;
 
+    if (m_IndexIds && m_IdIndex[DescriptionIndex].Buckets != NULL) {
+        return IndexLookupLocked(Id, DescriptionIndex);
+    }
+
     for (ple = m_DescriptionListHead.Blink;
          ple != &m_DescriptionListHead;
          ple = ple->Blink) {
@@ -2343,7 +2646,7 @@ FxChildList::CreateDevice(
                     // DeleteDeviceFromFailedCreate below will destroy this
                     // Entry due to the pnp state machine deleting the PDO.
                     //
-                    RemoveEntryList(&Entry->m_ModificationLink);
+                    RemoveModificationLocked(Entry);
                 }
                 KeReleaseSpinLock(&m_ListLock, irql);
 
@@ -2425,7 +2728,8 @@ FxChildList::ProcessBusRelations(
     PDEVICE_RELATIONS pPriorRelations, pNewRelations;
     PDEVICE_OBJECT pDevice;
     BOOLEAN needToReportMissingChildren, invalidateRelations, cleanupRelations;
-    ULONG additionalCount, totalCount, i;
+    BOOLEAN useSnapshot, settled, snapshotUpdated;
+    ULONG additionalCount, totalCount, firstObject, generation, i;
     size_t size;
     NTSTATUS status;
     KIRQL irql;
@@ -2436,6 +2740,8 @@ FxChildList::ProcessBusRelations(
     pNewRelations = NULL;
     invalidateRelations = FALSE;
     cleanupRelations = TRUE;
+    settled = TRUE;
+    firstObject = 0;
     InitializeListHead(&freeHead);
     pFxDriverGlobals = GetDriverGlobals();
 
@@ -2451,44 +2757,59 @@ FxChildList::ProcessBusRelations(
     additionalCount = 0;
     needToReportMissingChildren = FALSE;
 
-    for (ple = m_DescriptionListHead.Flink;
-         ple != &m_DescriptionListHead;
-         ple = ple->Flink) {
+    //
+    // If nothing that affects the reported children was committed since the
+    // last query, the snapshot taken then is still accurate: every
+    // description is either instantiated and in the snapshot or already
+    // reported missing.  Report it without walking the description list.
+    //
+    generation = m_RelationsGeneration;
+    useSnapshot = (m_RelationsSnapshotValid &&
+                   m_RelationsSnapshotGeneration == generation) ? TRUE : FALSE;
 
-        pEntry = FxDeviceDescriptionEntry::_FromDescriptionLink(ple);
+    if (useSnapshot) {
+        additionalCount = m_RelationsSnapshotCount;
+    }
+    else {
+        for (ple = m_DescriptionListHead.Flink;
+             ple != &m_DescriptionListHead;
+             ple = ple->Flink) {
 
-        switch (pEntry->m_DescriptionState) {
+            pEntry = FxDeviceDescriptionEntry::_FromDescriptionLink(ple);
 
-        case DescriptionPresentNeedsInstantiation:
-        case DescriptionInstantiatedHasObject:
-            //
-            // We'll be needing a DO here.
-            //
-            additionalCount++;
-            break;
+            switch (pEntry->m_DescriptionState) {
 
-        case DescriptionNotPresent:
-            //
-            // We will now report the description as missing
-            //
-            DoTraceLevelMessage(
-                pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPNP,
-                "PDO WDFDEVICE %p !devobj %p in a not present state, need to "
-                "report as missing",
-                pEntry->m_Pdo->GetHandle(), pEntry->m_Pdo->GetDeviceObject());
+            case DescriptionPresentNeedsInstantiation:
+            case DescriptionInstantiatedHasObject:
+                //
+                // We'll be needing a DO here.
+                //
+                additionalCount++;
+                break;
 
-            needToReportMissingChildren = TRUE;
-            break;
+            case DescriptionNotPresent:
+                //
+                // We will now report the description as missing
+                //
+                DoTraceLevelMessage(
+                    pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPNP,
+                    "PDO WDFDEVICE %p !devobj %p in a not present state, need to "
+                    "report as missing",
+                    pEntry->m_Pdo->GetHandle(), pEntry->m_Pdo->GetDeviceObject());
 
-        case DescriptionReportedMissing:
-            //
-            // Already reported missing in a previous handling of QDR
-            //
-            break;
+                needToReportMissingChildren = TRUE;
+                break;
 
-        default:
-            ASSERTMSG("Invalid description state\n", FALSE);
-            break;
+            case DescriptionReportedMissing:
+                //
+                // Already reported missing in a previous handling of QDR
+                //
+                break;
+
+            default:
+                ASSERTMSG("Invalid description state\n", FALSE);
+                break;
+            }
         }
     }
 
@@ -2574,6 +2895,8 @@ FxChildList::ProcessBusRelations(
                             "Could not allocate relations for %d devices",
                             totalCount);
 
+        settled = FALSE;
+
         //
         // Just like above, STATUS_NOT_SUPPORTED is a special value indicating
         // to the caller that the QDR has not been handled and that the caller
@@ -2715,12 +3038,33 @@ FxChildList::ProcessBusRelations(
                       _ComputeRelationsSize(pPriorRelations->Count));
     }
 
+    status = STATUS_SUCCESS;
+    firstObject = pNewRelations->Count;
+
+    if (useSnapshot) {
+        //
+        // The list is locked for enum, so no description can change state
+        // and release its PDO while we reference the snapshot.
+        //
+        for (i = 0; i < m_RelationsSnapshotCount; i++) {
+            pDevice = m_RelationsSnapshot[i];
+            ObReferenceObject(pDevice);
+            pNewRelations->Objects[pNewRelations->Count] = pDevice;
+            pNewRelations->Count++;
+        }
+
+        DoTraceLevelMessage(
+            pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPNP,
+            "WDFCHILDLIST %p reported %d PDOs from relations snapshot",
+            GetHandle(), m_RelationsSnapshotCount);
+
+        goto Done;
+    }
+
     //
     // We can walk the ChildList without holding the spinlock because we set
     // m_State to ListLockedForEnum.
     //
-    status = STATUS_SUCCESS;
-
     for (ple = m_DescriptionListHead.Flink;
          ple != &m_DescriptionListHead;
          ple = pNext) {
@@ -2736,6 +3080,7 @@ FxChildList::ProcessBusRelations(
             DoTraceLevelMessage(pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPNP,
                                 "Creating PDO device object from reported device");
             if (CreateDevice(pEntry, &invalidateRelations) == FALSE) {
+                settled = FALSE;
                 break;
             }
 
@@ -2783,8 +3128,24 @@ FxChildList::ProcessBusRelations(
     }
 
 Done:
+    //
+    // Remember what this list reported if the walk left every description
+    // settled.  Changes deferred while the list was locked for enum bump the
+    // generation when they are processed below, which invalidates the
+    // snapshot right away.
+    //
+    snapshotUpdated = FALSE;
+    if (useSnapshot == FALSE && settled) {
+        snapshotUpdated = UpdateRelationsSnapshot(pNewRelations, firstObject);
+    }
+
     KeAcquireSpinLock(&m_ListLock, &irql);
 
+    if (useSnapshot == FALSE) {
+        m_RelationsSnapshotValid = snapshotUpdated;
+        m_RelationsSnapshotGeneration = generation;
+    }
+
     //
     // Make sure that the description we just dequeued is not on the modification
     // list.
@@ -2836,6 +3197,62 @@ Done:
     return status;
 }
 
+BOOLEAN
+FxChildList::UpdateRelationsSnapshot(
+    __in_opt PDEVICE_RELATIONS Relations,
+    __in ULONG FirstObject
+    )
+/*++
+
+Routine Description:
+    Copies the device objects this list added to Relations, starting at
+    FirstObject, into the relations snapshot.  No references are taken, the
+    snapshot is only used while its generation matches which guarantees the
+    PDOs are still reported present.
+
+Arguments:
+    Relations - relations returned by the query, NULL if this list reported
+        nothing
+
+    FirstObject - index of the first object added by this list
+
+Return Value:
+    TRUE if the snapshot now describes the reported children
+
+  --*/
+{
+    PDEVICE_OBJECT* pSnapshot;
+    ULONG count;
+
+    count = (Relations != NULL) ? Relations->Count - FirstObject : 0;
+
+    if (count > m_RelationsSnapshotCapacity) {
+        pSnapshot = (PDEVICE_OBJECT*) FxPoolAllocate(
+            GetDriverGlobals(), NonPagedPool, count * sizeof(PDEVICE_OBJECT));
+
+        if (pSnapshot == NULL) {
+            return FALSE;
+        }
+
+        if (m_RelationsSnapshot != NULL) {
+            FxPoolFree(m_RelationsSnapshot);
+        }
+
+        m_RelationsSnapshot = pSnapshot;
+        m_RelationsSnapshotCapacity = count;
+    }
+
+    if (count > 0) {
+        RtlCopyMemory(m_RelationsSnapshot,
+                      &Relations->Objects[FirstObject],
+                      count * sizeof(PDEVICE_OBJECT));
+    }
+
+    m_RelationsSnapshotCount = count;
+
+    return TRUE;
+}
+
 VOID
 FxChildList::InvokeReportedMissingCallback(
     VOID
@@ -3036,6 +3453,8 @@ Return Value:
         }
     }
 
+    m_RelationsGeneration++;
+
     KeReleaseSpinLock(&m_ListLock, irql);
 
     DrainFreeListHead(&freeHead);
@@ -3118,7 +3537,7 @@ Return Value:
                             pEntry->m_Pdo->GetPhysicalDevice());
 
         ASSERT(pEntry->m_ModificationState == ModificationUnspecified);
-        RemoveEntryList(&pEntry->m_DescriptionLink);
+        RemoveDescriptionLocked(pEntry);
         InitializeListHead(&pEntry->m_DescriptionLink);
 
         KeReleaseSpinLock(&m_ListLock, irql);
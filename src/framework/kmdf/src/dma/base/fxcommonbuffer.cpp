@@ -40,6 +40,8 @@ FxCommonBuffer::FxCommonBuffer(
     m_BufferRawLA.QuadPart = NULL;   // allocated buffer phy base (unaligned)
     m_Length               = 0;
     m_RawLength            = 0;
+    m_Slab                 = NULL;
+    m_SlabBlock            = 0;
 
     MarkDisposeOverride(ObjectDoNotLock);
 
@@ -77,6 +79,38 @@ FxCommonBuffer::AllocateCommonBuffer(
 
     m_Length = Length;
 
+    //
+    // Drivers which opted in to the common buffer pool (CommonBufferPoolOn
+    // under Parameters\Wdf) get small buffers carved from the enabler's slabs
+    // instead of a dedicated allocation of at least a page.  Everyone else,
+    // and older drivers which get the padded allocation, keep the dedicated
+    // allocation below.
+    //
+    if (pFxDriverGlobals->FxCommonBufferPoolOn &&
+        FxCommonBufferPool::CanAllocate(Length, m_Alignment) &&
+        pFxDriverGlobals->IsVersionGreaterThanOrEqualTo(1,11)) {
+
+        status = m_DmaEnabler->GetCommonBufferPool()->Allocate(
+            Length,
+            m_Alignment,
+            &m_Slab,
+            &m_SlabBlock,
+            &m_BufferAlignedVA,
+            &m_BufferAlignedLA);
+
+        if (NT_SUCCESS(status)) {
+            m_RawLength = Length;
+            return status;
+        }
+
+        //
+        // Fall back to a dedicated allocation, which needs less contiguous
+        // memory than a slab.
+        //
+        m_Slab = NULL;
+        status = STATUS_SUCCESS;
+    }
+
     //
     // If required, add alignment to the length. 
     // If alignment is <= page-1, we actually don't need to do it b/c 
@@ -163,7 +197,11 @@ FxCommonBuffer::FreeCommonBuffer(
     //
     // Free this CommonBuffer per DmaEnabler
     //
-    if (m_BufferRawVA != NULL) {
+    if (m_Slab != NULL) {
+        m_DmaEnabler->GetCommonBufferPool()->Free(m_Slab, m_SlabBlock);
+        m_Slab = NULL;
+    }
+    else if (m_BufferRawVA != NULL) {
         m_DmaEnabler->FreeCommonBuffer((ULONG) m_RawLength,
                                         m_BufferRawVA,
                                         m_BufferRawLA);
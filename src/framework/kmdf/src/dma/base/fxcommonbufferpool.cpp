@@ -0,0 +1,298 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+
+Module Name:
+
+    FxCommonBufferPool.cpp
+
+Abstract:
+
+    Sub-allocator which carves small common buffers out of larger common
+    buffer slabs allocated from a DMA enabler.
+
+Environment:
+
+    Kernel mode only.
+
+Notes:
+
+
+Revision History:
+
+--*/
+
+#include "FxDmaPCH.hpp"
+
+extern "C" {
+#include "FxCommonBufferPool.tmh"
+}
+
+FxCommonBufferPool::FxCommonBufferPool(
+    VOID
+    )
+{
+    ULONG i;
+
+    m_DmaEnabler = NULL;
+
+    for (i = 0; i < FX_COMMON_BUFFER_POOL_CLASSES; i++) {
+        InitializeListHead(&m_Classes[i].PartialSlabs);
+        InitializeListHead(&m_Classes[i].FullSlabs);
+    }
+}
+
+VOID
+FxCommonBufferPool::Initialize(
+    __in FxDmaEnabler* DmaEnabler
+    )
+{
+    m_DmaEnabler = DmaEnabler;
+}
+
+_Must_inspect_result_
+FxCommonBufferSlab*
+FxCommonBufferPool::AllocateSlab(
+    __in ULONG Class
+    )
+/*++
+
+Routine Description:
+    Allocates a new slab for the given class from the DMA enabler and threads
+    all of its blocks on the slab's free list.  Must be called at passive
+    level without the pool lock held.
+
+Arguments:
+    Class - size class the slab is carved into
+
+Return Value:
+    The new slab or NULL on failure
+
+  --*/
+{
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    FxCommonBufferSlab* pSlab;
+    ULONG blockSize, blockCount, i;
+
+    pFxDriverGlobals = m_DmaEnabler->GetDriverGlobals();
+
+    blockSize = FX_COMMON_BUFFER_POOL_MIN_BLOCK << Class;
+    blockCount = FX_COMMON_BUFFER_POOL_SLAB_SIZE / blockSize;
+
+    pSlab = (FxCommonBufferSlab*) FxPoolAllocate(
+        pFxDriverGlobals,
+        NonPagedPool,
+        FIELD_OFFSET(FxCommonBufferSlab, NextFree) + blockCount * sizeof(ULONG));
+
+    if (pSlab == NULL) {
+        return NULL;
+    }
+
+    m_DmaEnabler->AllocateCommonBuffer(FX_COMMON_BUFFER_POOL_SLAB_SIZE,
+                                       &pSlab->BufferVA,
+                                       &pSlab->BufferLA);
+    if (pSlab->BufferVA == NULL) {
+        FxPoolFree(pSlab);
+        return NULL;
+    }
+
+    //
+    // AllocateCommonBuffer returns page aligned memory, which is what makes
+    // every power of two block naturally aligned.
+    //
+    ASSERT(((ULONG_PTR) pSlab->BufferVA & (PAGE_SIZE - 1)) == 0);
+    ASSERT((pSlab->BufferLA.QuadPart & (PAGE_SIZE - 1)) == 0);
+
+    pSlab->Class = Class;
+    pSlab->BlockSize = blockSize;
+    pSlab->BlockCount = blockCount;
+    pSlab->FreeCount = blockCount;
+    pSlab->FreeHead = 0;
+
+    for (i = 0; i < blockCount - 1; i++) {
+        pSlab->NextFree[i] = i + 1;
+    }
+    pSlab->NextFree[blockCount - 1] = FX_COMMON_BUFFER_POOL_NO_BLOCK;
+
+    DoTraceLevelMessage(pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGDMA,
+                        "WDFDMAENABLER %p: common buffer slab VA %p LA %I64x "
+                        "carved into %d blocks of %d bytes",
+                        m_DmaEnabler->GetHandle(), pSlab->BufferVA,
+                        pSlab->BufferLA.QuadPart, blockCount, blockSize);
+
+    return pSlab;
+}
+
+VOID
+FxCommonBufferPool::FreeSlab(
+    __in FxCommonBufferSlab* Slab
+    )
+{
+    ASSERT(Slab->FreeCount == Slab->BlockCount);
+
+    m_DmaEnabler->FreeCommonBuffer(FX_COMMON_BUFFER_POOL_SLAB_SIZE,
+                                   Slab->BufferVA,
+                                   Slab->BufferLA);
+    FxPoolFree(Slab);
+}
+
+_Must_inspect_result_
+NTSTATUS
+FxCommonBufferPool::Allocate(
+    __in size_t Length,
+    __in size_t Alignment,
+    __deref_out FxCommonBufferSlab** Slab,
+    __out PULONG Block,
+    __deref_out PVOID* BufferVA,
+    __out PHYSICAL_ADDRESS* BufferLA
+    )
+/*++
+
+Routine Description:
+    Allocates a block of at least Length bytes aligned to Alignment + 1 in
+    both its virtual and logical address.  A new slab is allocated from the
+    enabler only when every slab of the size class is full.
+
+Arguments:
+    Length - requested length, must satisfy CanAllocate
+
+    Alignment - alignment mask, must satisfy CanAllocate
+
+    Slab, Block - identify the block, passed back to Free
+
+    BufferVA, BufferLA - addresses of the block
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    FxCommonBufferPoolClass* pClass;
+    FxCommonBufferSlab* pSlab;
+    FxCommonBufferSlab* pNewSlab;
+    size_t blockSize;
+    ULONG cls, block;
+    KIRQL irql;
+
+    ASSERT(CanAllocate(Length, Alignment));
+
+    blockSize = FX_COMMON_BUFFER_POOL_MIN_BLOCK;
+    cls = 0;
+
+    while (blockSize < Length || blockSize < Alignment + 1) {
+        blockSize <<= 1;
+        cls++;
+    }
+
+    ASSERT(cls < FX_COMMON_BUFFER_POOL_CLASSES);
+
+    pClass = &m_Classes[cls];
+    pNewSlab = NULL;
+
+    m_Lock.Acquire(&irql);
+
+    if (IsListEmpty(&pClass->PartialSlabs)) {
+        m_Lock.Release(irql);
+
+        pNewSlab = AllocateSlab(cls);
+        if (pNewSlab == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        m_Lock.Acquire(&irql);
+
+        //
+        // Put the new slab behind any slab freed up while the lock was
+        // dropped so that partially used slabs are filled first.
+        //
+        InsertTailList(&pClass->PartialSlabs, &pNewSlab->ListEntry);
+    }
+
+    pSlab = CONTAINING_RECORD(pClass->PartialSlabs.Flink,
+                              FxCommonBufferSlab,
+                              ListEntry);
+
+    block = pSlab->FreeHead;
+    ASSERT(block != FX_COMMON_BUFFER_POOL_NO_BLOCK);
+
+    pSlab->FreeHead = pSlab->NextFree[block];
+    pSlab->FreeCount--;
+
+    if (pSlab->FreeCount == 0) {
+        RemoveEntryList(&pSlab->ListEntry);
+        InsertTailList(&pClass->FullSlabs, &pSlab->ListEntry);
+    }
+
+    m_Lock.Release(irql);
+
+    *Slab = pSlab;
+    *Block = block;
+    *BufferVA = WDF_PTR_ADD_OFFSET(pSlab->BufferVA, block * pSlab->BlockSize);
+    BufferLA->QuadPart = pSlab->BufferLA.QuadPart +
+                         (ULONGLONG) block * pSlab->BlockSize;
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+FxCommonBufferPool::Free(
+    __in FxCommonBufferSlab* Slab,
+    __in ULONG Block
+    )
+/*++
+
+Routine Description:
+    Returns a block to its slab.  Slabs are kept until the pool is destroyed
+    so that steady state create/delete of common buffers does not go back to
+    the enabler.
+
+  --*/
+{
+    FxCommonBufferPoolClass* pClass;
+    KIRQL irql;
+
+    ASSERT(Block < Slab->BlockCount);
+
+    pClass = &m_Classes[Slab->Class];
+
+    m_Lock.Acquire(&irql);
+
+    if (Slab->FreeCount == 0) {
+        RemoveEntryList(&Slab->ListEntry);
+        InsertHeadList(&pClass->PartialSlabs, &Slab->ListEntry);
+    }
+
+    Slab->NextFree[Block] = Slab->FreeHead;
+    Slab->FreeHead = Block;
+    Slab->FreeCount++;
+
+    m_Lock.Release(irql);
+}
+
+VOID
+FxCommonBufferPool::Destroy(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Frees every slab back to the enabler.  Called when the enabler is disposed,
+    after all of its child common buffers have been disposed and before the
+    enabler's adapter objects are released.
+
+  --*/
+{
+    FxCommonBufferSlab* pSlab;
+    PLIST_ENTRY ple;
+    ULONG i;
+
+    for (i = 0; i < FX_COMMON_BUFFER_POOL_CLASSES; i++) {
+        ASSERT(IsListEmpty(&m_Classes[i].FullSlabs));
+
+        while (!IsListEmpty(&m_Classes[i].PartialSlabs)) {
+            ple = RemoveHeadList(&m_Classes[i].PartialSlabs);
+            pSlab = CONTAINING_RECORD(ple, FxCommonBufferSlab, ListEntry);
+            FreeSlab(pSlab);
+        }
+    }
+}
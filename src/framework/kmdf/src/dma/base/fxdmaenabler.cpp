@@ -65,18 +65,38 @@ FxDmaEnabler::FxDmaEnabler(
 
     RtlZeroMemory(&m_SGList, sizeof(m_SGList));
 
+    m_SGListCache = NULL;
+
+    m_CommonBufferPool.Initialize(this);
+
     MarkDisposeOverride(ObjectDoNotLock);
 }
 
 FxDmaEnabler::~FxDmaEnabler()
 {
+    PSLIST_ENTRY pEntry;
+    ULONG i;
+
     if (m_IsSGListAllocated) {
         if (m_IsScatterGather) {
             //
-            // Scatter Gather profile - cleanup the lookaside list
+            // Scatter Gather profile - return the cached SG list buffers and
+            // cleanup the lookaside list
             //
+            for (i = 0; i < FX_DMA_SGLIST_CACHE_SHARDS; i++) {
+                while ((pEntry = InterlockedPopEntrySList(
+                            &m_SGListCache[i].ListHead)) != NULL) {
+                    FxFreeToNPagedLookasideList(
+                        &m_SGList.ScatterGatherProfile.Lookaside,
+                        pEntry);
+                }
+            }
+
             ExDeleteNPagedLookasideList(&m_SGList.ScatterGatherProfile.Lookaside);
 
+            ExFreePool(m_SGListCache);
+            m_SGListCache = NULL;
+
         } else if (!m_IsBusMaster) {
             //
             // System profile (not busmastering) - cleanup the preallocated
@@ -102,6 +122,12 @@ FxDmaEnabler::~FxDmaEnabler()
 BOOLEAN
 FxDmaEnabler::Dispose()
 {
+    //
+    // Child common buffers have already been disposed and returned their
+    // blocks, give the slabs back while the adapter is still around.
+    //
+    m_CommonBufferPool.Destroy();
+
     ReleaseResources();
 
     if (m_IsAdded) {
@@ -610,6 +636,7 @@ FxDmaEnabler::ConfigureBusMasterAdapters(
 {
     ULONG alignment;
     NTSTATUS status;
+    ULONG i;
 
     //
     // Initialize map register management
@@ -718,6 +745,27 @@ FxDmaEnabler::ConfigureBusMasterAdapters(
         if ((Config->Flags & WDF_DMA_ENABLER_CONFIG_NO_SGLIST_PREALLOCATION) == 0) {
             ASSERT(m_IsSGListAllocated == FALSE);
 
+            m_SGListCache = (FxDmaSGListCacheShard*) ExAllocatePoolWithTag(
+                NonPagedPoolCacheAligned,
+                sizeof(FxDmaSGListCacheShard) * FX_DMA_SGLIST_CACHE_SHARDS,
+                GetDriverGlobals()->Tag);
+
+            if (m_SGListCache == NULL) {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                DoTraceLevelMessage(
+                    GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGDMA,
+                    "Unable to allocate scatter gather list cache for DMA "
+                    "enabler %p, %!STATUS!",
+                    GetHandle(), status
+                    );
+                goto End;
+            }
+
+            for (i = 0; i < FX_DMA_SGLIST_CACHE_SHARDS; i++) {
+                InitializeSListHead(&m_SGListCache[i].ListHead);
+                m_SGListCache[i].Depth = 0;
+            }
+
             m_SGListSize = sgLookasideListSize;
 
             ExInitializeNPagedLookasideList( &m_SGList.ScatterGatherProfile.Lookaside,
@@ -1045,6 +1093,72 @@ FxDmaEnabler::PowerDown(
     return status;
 }
 
+// ----------------------------------------------------------------------------
+// ------------------------ SG LIST BUFFER SECTION -----------------------------
+// ----------------------------------------------------------------------------
+
+_Must_inspect_result_
+PVOID
+FxDmaEnabler::AllocateSGListBuffer(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Allocates a buffer of m_SGListSize bytes for a scatter gather transaction
+    to build its SG list in.  The current processor's cache is tried first,
+    then the enabler's lookaside list.
+
+Return Value:
+    The buffer or NULL on failure
+
+  --*/
+{
+    FxDmaSGListCacheShard* pShard;
+    PVOID pBuffer;
+
+    ASSERT(m_IsScatterGather && m_IsSGListAllocated);
+
+    pShard = &m_SGListCache[Mx::MxGetCurrentProcessorNumber() &
+                                (FX_DMA_SGLIST_CACHE_SHARDS - 1)];
+
+    pBuffer = InterlockedPopEntrySList(&pShard->ListHead);
+    if (pBuffer != NULL) {
+        InterlockedDecrement(&pShard->Depth);
+        return pBuffer;
+    }
+
+    return FxAllocateFromNPagedLookasideList(
+        &m_SGList.ScatterGatherProfile.Lookaside);
+}
+
+VOID
+FxDmaEnabler::FreeSGListBuffer(
+    __in PVOID Buffer
+    )
+/*++
+
+Routine Description:
+    Returns a buffer allocated by AllocateSGListBuffer to the current
+    processor's cache, or to the lookaside list if that cache is full.
+
+  --*/
+{
+    FxDmaSGListCacheShard* pShard;
+
+    pShard = &m_SGListCache[Mx::MxGetCurrentProcessorNumber() &
+                                (FX_DMA_SGLIST_CACHE_SHARDS - 1)];
+
+    if (pShard->Depth >= FX_DMA_SGLIST_CACHE_MAX_DEPTH) {
+        FxFreeToNPagedLookasideList(&m_SGList.ScatterGatherProfile.Lookaside,
+                                    Buffer);
+        return;
+    }
+
+    InterlockedIncrement(&pShard->Depth);
+    InterlockedPushEntrySList(&pShard->ListHead, (PSLIST_ENTRY) Buffer);
+}
+
 // ----------------------------------------------------------------------------
 // ------------------------ COMMON BUFFER SECTION -----------------------------
 // ----------------------------------------------------------------------------
@@ -799,12 +799,10 @@ FxDmaScatterGatherTransaction::_Create(
     if (NT_SUCCESS(status) && DmaEnabler->m_IsSGListAllocated) {
 
         //
-        // Allocate buffer for SGList from lookaside list.
+        // Allocate buffer for SGList from the enabler's cache.
         //
         pTransaction->m_LookasideBuffer = (SCATTER_GATHER_LIST *)
-            FxAllocateFromNPagedLookasideList(
-                &DmaEnabler->m_SGList.ScatterGatherProfile.Lookaside
-                );
+            DmaEnabler->AllocateSGListBuffer();
 
         if (pTransaction->m_LookasideBuffer == NULL) {
             status = STATUS_INSUFFICIENT_RESOURCES;
@@ -849,10 +847,7 @@ FxDmaScatterGatherTransaction::Dispose(
     //
     if (m_LookasideBuffer != NULL) {
 
-        FxFreeToNPagedLookasideList(
-            &m_DmaEnabler->m_SGList.ScatterGatherProfile.Lookaside,
-            m_LookasideBuffer
-            );
+        m_DmaEnabler->FreeSGListBuffer(m_LookasideBuffer);
         m_LookasideBuffer = NULL;
         m_DmaEnabler->RELEASE(this);
     }
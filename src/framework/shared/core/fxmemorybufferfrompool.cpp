@@ -42,6 +42,7 @@ Return Value:
   --*/
 {
     m_Pool = NULL;
+    m_NonPaged = FALSE;
 }
 
 FxMemoryBufferFromPool::FxMemoryBufferFromPool(
@@ -66,6 +67,7 @@ Return Value:
   --*/
 {
     m_Pool = NULL;
+    m_NonPaged = FALSE;
 }
 
 FxMemoryBufferFromPool::~FxMemoryBufferFromPool()
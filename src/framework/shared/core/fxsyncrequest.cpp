@@ -60,6 +60,10 @@ Return Value:
     // destructor so that the base class destructor does not free the context.
     // This is useful if the context is also stack based.
     //
+    m_Event = m_DestroyedEvent.GetSelfPointer();
+    m_Shell = NULL;
+    m_ShellTarget = NULL;
+
     if (Context != NULL) {
         m_ClearContextOnDestroy = TRUE;
     }   
@@ -137,6 +141,48 @@ Return Value:
        m_TrueRequest->m_RequestBaseFlags &= ~FxRequestBaseSyncCleanupContext;
     }
     
+    if (count > 0) {
+        DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIO,
+                            "Request %p, waiting on event %p",
+                            this, m_Event->GetEvent());
+
+        m_Event->EnterCRAndWaitAndLeave();
+
+        DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIO,
+                            "Request %p, wait on event %p done",
+                            this, m_Event->GetEvent());
+    }
+
+    if (m_Shell != NULL) {
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+        if (m_TrueRequest == this && m_Shell->Irp != NULL) {
+            if (GetSubmitIrp() == m_Shell->Irp) {
+                //
+                // The irp goes back to the pool, restore it while it is
+                // still ours, context included, and detach it so the base
+                // destructor leaves it alone.
+                //
+                if (m_RequestContext != NULL) {
+                    m_RequestContext->ReleaseAndRestore(this);
+                }
+
+                (VOID) SetSubmitIrp(NULL, FALSE);
+            }
+            else {
+                //
+                // ValidateTarget needed more stack locations, freed the
+                // lent irp and gave us one of our own, which the base
+                // destructor frees.
+                //
+                m_Shell->Irp = NULL;
+                m_Shell->StackSize = 0;
+            }
+        }
+#endif
+        m_ShellTarget->ReleaseSyncShell(m_Shell);
+        m_Shell = NULL;
+    }
+
     //
     // Clear the context so that it is not automatically deleted.  Useful
     // if the caller's context is also allocated on the stack and does not
@@ -146,18 +192,54 @@ Return Value:
     if (m_ClearContextOnDestroy) {
         m_RequestContext = NULL;
     }
+}
 
-    if (count > 0) {
-        DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIO,
-                            "Request %p, waiting on event %p",
-                            this, m_DestroyedEvent.GetEvent());
+NTSTATUS
+FxSyncRequest::Initialize(
+    __in FxIoTarget* Target
+    )
+/*++
 
-        m_DestroyedEvent.EnterCRAndWaitAndLeave();
+Routine Description:
+    Initializes the request with resources borrowed from Target's sync
+    request shell pool instead of creating them for this call.  The shell's
+    event serves both as this object's destroyed event and, when the caller
+    passes m_Shell to SubmitSync, as the event the send waits on.  A request
+    without a WDFREQUEST also borrows the shell's preallocated irp.  The irp
+    is marked as internally allocated so that ValidateTarget may still trade
+    it for one with more stack locations; the destructor gives the irp back
+    to the pool unless that happened.  If the pool cannot provide a shell,
+    falls back to Initialize().
 
-        DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIO,
-                            "Request %p, wait on event %p done",
-                            this, m_DestroyedEvent.GetEvent());
+Arguments:
+    Target - target the request will be sent to
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    FxSyncRequestShell* pShell;
+
+    pShell = Target->AcquireSyncShell(m_TrueRequest == this ? TRUE : FALSE);
+    if (pShell == NULL) {
+        return Initialize();
+    }
+
+    m_Shell = pShell;
+    m_ShellTarget = Target;
+    m_Event = pShell->Event.GetSelfPointer();
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    if (m_TrueRequest == this && pShell->Irp != NULL) {
+        ASSERT(GetSubmitIrp() == NULL);
+
+        (VOID) SetSubmitIrp(pShell->Irp, FALSE);
+        m_IrpAllocation = REQUEST_ALLOCATED_INTERNAL;
     }
+#endif
+
+    return STATUS_SUCCESS;
 }
 
 VOID
@@ -185,7 +267,7 @@ Return Value:
 {
     DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIO,
                         "SyncRequest %p, signaling event %p on SelfDestruct",
-                        this, m_DestroyedEvent.GetEvent());
+                        this, m_Event->GetEvent());
 
-    m_DestroyedEvent.Set();
+    m_Event->Set();
 }
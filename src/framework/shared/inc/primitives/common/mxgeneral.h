@@ -87,6 +87,12 @@ public:
     MxGetCurrentIrql(
         );
 
+    FORCEINLINE
+    static
+    ULONG
+    MxGetCurrentProcessorNumber(
+        );
+
     __drv_maxIRQL(HIGH_LEVEL)
     __drv_raisesIRQL(NewIrql)
     FORCEINLINE
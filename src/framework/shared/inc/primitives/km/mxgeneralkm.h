@@ -89,6 +89,14 @@ Mx::MxGetCurrentIrql(
     return KeGetCurrentIrql();
 }
 
+FORCEINLINE
+ULONG
+Mx::MxGetCurrentProcessorNumber(
+    )
+{
+    return KeGetCurrentProcessorNumberEx(NULL);
+}
+
 __drv_maxIRQL(HIGH_LEVEL)
 __drv_raisesIRQL(NewIrql)
 FORCEINLINE
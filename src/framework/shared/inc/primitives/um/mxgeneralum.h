@@ -141,6 +141,14 @@ Mx::MxGetCurrentIrql(
     return PASSIVE_LEVEL;
 }
 
+FORCEINLINE
+ULONG
+Mx::MxGetCurrentProcessorNumber(
+    )
+{
+    return GetCurrentProcessorNumber();
+}
+
 FORCEINLINE
 VOID
 #pragma prefast(suppress:__WARNING_UNMATCHED_DECL_ANNO, "Can't apply kernel mode annotations.");
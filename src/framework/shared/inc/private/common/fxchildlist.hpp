@@ -92,6 +92,29 @@ enum FxChildListState {
     ListLockedForParentRemove,
 };
 
+//
+// Hash index over the identification descriptions of the entries in either the
+// description or the modification list.  Each bucket links entries through
+// FxDeviceDescriptionEntry::m_IdHashLink[] with the most recently inserted
+// entry at the head, which preserves the backwards search order of the list.
+//
+struct FxChildListIdIndex {
+    //
+    // NULL if the index could not be allocated, the list is then searched
+    // linearly
+    //
+    PLIST_ENTRY Buckets;
+
+    ULONG BucketCount;
+
+    ULONG Count;
+};
+
+enum FxChildListIdIndexValues {
+    FX_CHILD_LIST_ID_INDEX_MIN_BUCKETS = 16,
+    FX_CHILD_LIST_ID_INDEX_MAX_BUCKETS = 4096,
+};
+
 enum FxChildListScanTagStates {
     ScanTagUndefined = 0,
     ScanTagActive,
@@ -396,6 +419,10 @@ protected:
         __in BOOLEAN Static
         );
 
+    ~FxChildList(
+        VOID
+        );
+
     virtual
     BOOLEAN
     Dispose(
@@ -442,6 +469,54 @@ protected:
         __inout PLIST_ENTRY FreeListHead
         );
 
+    VOID
+    InsertDescriptionLocked(
+        __inout FxDeviceDescriptionEntry* Entry
+        );
+
+    VOID
+    RemoveDescriptionLocked(
+        __inout FxDeviceDescriptionEntry* Entry
+        );
+
+    VOID
+    InsertModificationLocked(
+        __inout FxDeviceDescriptionEntry* Entry
+        );
+
+    VOID
+    RemoveModificationLocked(
+        __inout FxDeviceDescriptionEntry* Entry
+        );
+
+    ULONG
+    HashId(
+        __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
+        );
+
+    VOID
+    IndexInsertLocked(
+        __inout FxDeviceDescriptionEntry* Entry,
+        __in FxChildListIteratorIndexValues Index
+        );
+
+    VOID
+    IndexRemoveLocked(
+        __inout FxDeviceDescriptionEntry* Entry,
+        __in FxChildListIteratorIndexValues Index
+        );
+
+    BOOLEAN
+    RebuildIndexLocked(
+        __in FxChildListIteratorIndexValues Index
+        );
+
+    FxDeviceDescriptionEntry*
+    IndexLookupLocked(
+        __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id,
+        __in FxChildListIteratorIndexValues Index
+        );
+
     FxDeviceDescriptionEntry*
     SearchBackwardsForMatchingModificationLocked(
         __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
@@ -470,6 +545,12 @@ protected:
         __inout PBOOLEAN InvalidateRelations
         );
 
+    BOOLEAN
+    UpdateRelationsSnapshot(
+        __in_opt PDEVICE_RELATIONS Relations,
+        __in ULONG FirstObject
+        );
+
     _Must_inspect_result_
     NTSTATUS
     DuplicateId(
@@ -610,6 +691,41 @@ protected:
 
     LIST_ENTRY m_ModificationListHead;
 
+    //
+    // Hash indices over m_DescriptionListHead and m_ModificationListHead,
+    // indexed by FxChildListIteratorIndexValues.  Only maintained when
+    // m_IndexIds is TRUE, which is when identification descriptions are
+    // compared bytewise so that equal descriptions always hash the same.
+    // Protected by m_ListLock.
+    //
+    FxChildListIdIndex m_IdIndex[2];
+
+    BOOLEAN m_IndexIds;
+
+    //
+    // Incremented under m_ListLock whenever a change which affects the set of
+    // children reported in bus relations is committed to the description
+    // list.
+    //
+    ULONG m_RelationsGeneration;
+
+    //
+    // Device objects this list reported in the last bus relations query and
+    // the value of m_RelationsGeneration they were computed at.  While the
+    // generation is unchanged the next query reports the snapshot without
+    // walking the description list.  Only touched by ProcessBusRelations,
+    // the valid flag and generation are read and written under m_ListLock.
+    //
+    PDEVICE_OBJECT* m_RelationsSnapshot;
+
+    ULONG m_RelationsSnapshotCount;
+
+    ULONG m_RelationsSnapshotCapacity;
+
+    ULONG m_RelationsSnapshotGeneration;
+
+    BOOLEAN m_RelationsSnapshotValid;
+
     FxChildListState m_State;
 
     BOOLEAN m_InvalidationNeeded;
@@ -787,6 +903,18 @@ protected:
                                  m_ModificationLink);
     }
 
+    static
+    FxDeviceDescriptionEntry*
+    _FromIdHashLink(
+        __in PLIST_ENTRY Link,
+        __in FxChildListIteratorIndexValues Index
+        )
+    {
+        return CONTAINING_RECORD(Link - Index,
+                                 FxDeviceDescriptionEntry,
+                                 m_IdHashLink);
+    }
+
 protected:
     LIST_ENTRY m_DescriptionLink;
 
@@ -811,6 +939,14 @@ protected:
     BOOLEAN m_PendingDeleteOnScanEnd;
 
     FxChildListReportedMissingCallbackState m_ReportedMissingCallbackState;
+
+    //
+    // Links into the owning list's description and modification hash
+    // indices, indexed by FxChildListIteratorIndexValues
+    //
+    LIST_ENTRY m_IdHashLink[2];
+
+    ULONG m_IdHash;
 };
 
 #endif // _FXDEVICELIST_H_
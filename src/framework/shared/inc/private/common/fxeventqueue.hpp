@@ -161,6 +161,27 @@ struct FxEventQueue : public FxStump {
         return (m_QueueFlags & FxEventQueueFlagClosed) ? TRUE : FALSE;
     }
 
+    BOOLEAN
+    ClaimWorkItemLocked(
+        VOID
+        )
+    {
+        //
+        // Called by a poster which already knows it cannot run the state
+        // machine on its own thread, right after inserting its event.  Doing
+        // QueueToThreadWorker's bookkeeping under the same acquisition of the
+        // queue lock saves a second acquisition per post.  If the work item
+        // is already queued it will pick up the new event and there is
+        // nothing more for the poster to do.
+        //
+        if (m_QueueFlags & FxEventQueueFlagWorkItemQueued) {
+            return FALSE;
+        }
+
+        m_QueueFlags |= FxEventQueueFlagWorkItemQueued;
+        return TRUE;
+    }
+
     VOID
     GetFinishedState(
         __inout FxPostProcessInfo* Info
@@ -314,6 +335,17 @@ struct FxWorkItemEventQueue : public FxEventQueue {
         }
     }
 
+    VOID
+    QueueClaimedWorkItem(
+        VOID
+        )
+    {
+        //
+        // The caller got TRUE back from ClaimWorkItemLocked
+        //
+        QueueWorkItem();
+    }
+
 protected:
     VOID
     QueueWorkItem(
@@ -358,6 +390,17 @@ struct FxThreadedEventQueue : public FxEventQueue {
         }
     }
 
+    VOID
+    QueueClaimedWorkItem(
+        VOID
+        )
+    {
+        //
+        // The caller got TRUE back from ClaimWorkItemLocked
+        //
+        QueueWorkItem();
+    }
+
 protected:
     static
     WORKER_THREAD_ROUTINE 
@@ -138,6 +138,16 @@ struct FxDriverGlobalsDebugExtension {
     // and optionally capture stack frames.
     //
     FxTrackPowerOption TrackPower;
+
+    //
+    // When greater than 1, only one in TrackHandlesSampleRate objects of a
+    // type listed in TrackHandles gets a tag tracker.  This keeps reference
+    // tracking cheap enough to leave on under load.  TrackHandlesSampleCounter
+    // is the running count of candidate objects used to pick the sample.
+    //
+    ULONG TrackHandlesSampleRate;
+
+    volatile LONG TrackHandlesSampleCounter;
 };
 
 //
@@ -388,11 +398,12 @@ public:
     BOOLEAN FxPoolTrackingOn;
 
     //
-    // FxVerifierLock per driver state
+    // FxVerifierLock per driver state.  ThreadTableLock only guards allocation
+    // and teardown of ThreadTable; each bucket of the table has its own lock.
     //
     MxLock ThreadTableLock;
 
-    PLIST_ENTRY ThreadTable;
+    struct FxVerifierThreadTableBucket* ThreadTable;
 
     //
     // Embedded pointer to driver's WDF_BIND_INFO structure (in stub)
@@ -466,6 +477,50 @@ public:
     //
     BOOLEAN FxDsfOn;
 
+    //
+    // Carve small common buffers from per DMA enabler slabs.  Off unless the
+    // driver opts in through its Parameters\Wdf key.
+    //
+    BOOLEAN FxCommonBufferPoolOn;
+
+    //
+    // Queue asynchronous I/O target completions and deliver them in batches
+    // from a DPC.  Off unless the driver opts in through its Parameters\Wdf
+    // key.
+    //
+    BOOLEAN FxIoTargetCompletionQueueOn;
+
+    //
+    // Merge transfers formatted for bulk and interrupt OUT pipes through the
+    // pipe's write coalescer.  Off unless the driver opts in through its
+    // Parameters\Wdf key.  Meant for pipes carrying a byte stream, since
+    // transfer boundaries are not preserved.
+    //
+    BOOLEAN FxUsbWriteCoalescingOn;
+
+    //
+    // Number of merged transfers a pipe's write coalescer keeps in flight,
+    // from UsbWriteCoalescingTransfers under Parameters\Wdf.  Zero picks the
+    // default.
+    //
+    ULONG FxUsbWriteCoalescingTransfers;
+
+    //
+    // Hand non paged memory objects to WdfDeviceIoBuffered targets as the
+    // system buffer instead of double buffering them.  Off unless the driver
+    // opts in through its Parameters\Wdf key, and only honored for drivers
+    // built against 1.15 or later, since a driver may rely on the copy and
+    // touch the memory while the request is pending.
+    //
+    BOOLEAN FxIoTargetDirectBufferedIoOn;
+
+    //
+    // UMDF only.  Upper bound, in microseconds, of the spin done by an
+    // interrupt's threadpool callback before it re-registers its wait.  Zero,
+    // the default, turns spin delivery off.
+    //
+    ULONG FxInterruptSpinDeliveryMaxUs;
+
     //
     // Force copy of IFR data to mini-dump when a bugcheck happens.
     //
@@ -656,6 +711,11 @@ FxVerifierLockDestroy(
     __in PFX_DRIVER_GLOBALS FxDriverGlobals
     );
 
+VOID
+FxVerifierLockInitializeOrderMaps(
+    VOID
+    );
+
 _Must_inspect_result_
 BOOLEAN
 FxVerifierGetTrackReferences(
@@ -695,6 +755,14 @@ enum FxMachineSleepStates {
     FxMachineSleepStatesMax,
 };
 
+//
+// All FX_OBJECT_TYPES values (other than FX_TYPE_NONE) fall within
+// [FX_TYPES_BASE, FX_TYPES_INTERFACES_BASE + 0x100).  This is the size of the
+// WDFTYPE -> FxObjectsInfo index map kept in FxLibraryGlobals.
+//
+#define FX_OBJECT_INFO_INDEX_MAP_SIZE \
+    (FX_TYPES_INTERFACES_BASE + 0x100 - FX_TYPES_BASE)
+
 //
 // Private Globals for the entire DLL
 
@@ -830,6 +898,14 @@ struct FxLibraryGlobalsType {
 
     BOOLEAN MachineSleepStates[FxMachineSleepStatesMax];
 
+    //
+    // Direct-indexed map from WDFTYPE to its position in FxObjectsInfo (and
+    // therefore in every FxObjectDebugInfo array).  Each entry holds the
+    // table index + 1 so that a zero entry means "not in the table".  Built
+    // once in FxLibraryGlobalsCommission.
+    //
+    UCHAR ObjectsInfoIndexMap[FX_OBJECT_INFO_INDEX_MAP_SIZE];
+
 #if (FX_CORE_MODE==FX_CORE_KERNEL_MODE)
     //
     // used for locking/unlocking Enhanced-verifier image section
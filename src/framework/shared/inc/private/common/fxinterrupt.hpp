@@ -631,6 +631,16 @@ private:
         VOID
         );
 
+    BOOLEAN
+    InvokeThreadpoolIsr(
+        __in BOOLEAN FromSpin
+        );
+
+    VOID
+    AcknowledgeThreadpoolInterrupt(
+        __in BOOLEAN Claimed
+        );
+
     VOID
     QueueSingleWaitOnInterruptEvent(
         VOID
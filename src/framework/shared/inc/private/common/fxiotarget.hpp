@@ -28,6 +28,128 @@ Revision History:
 #ifndef _FXIOTARGET_H_
 #define _FXIOTARGET_H_
 
+struct FxIoBounceBufferCache;
+class FxIoTarget;
+
+//
+// Called when the oldest entry of the completion queue is ready and no drain
+// is known to pick it up, so the owner can schedule its DPC or thread to
+// drain the queue.
+//
+typedef
+VOID
+(*PFN_FX_IO_TARGET_COMPLETION_QUEUE_NOTIFY)(
+    __in FxIoTarget* Target,
+    __in PVOID Context
+    );
+
+//
+// Bounded multi producer, single consumer ring of completed requests.
+// Producers reserve a slot by advancing Tail with a compare exchange and then
+// publish the request in the slot; the consumer advances Head and treats a
+// NULL slot as a reservation which has not been published yet.  Head and Tail
+// are free running, the capacity is a power of two no larger than
+// FX_IO_COMPLETION_QUEUE_MAX_CAPACITY.
+//
+#define FX_IO_COMPLETION_QUEUE_MAX_CAPACITY (0x10000)
+
+//
+// Size of the completion queue of a target whose driver opted in to queued
+// completion, and the number of completions its DPC delivers per run.
+//
+#define FX_IO_COMPLETION_QUEUE_CAPACITY     (256)
+#define FX_IO_COMPLETION_QUEUE_DRAIN_BUDGET (64)
+
+//
+// Resources for one synchronous send, recycled through a per target pool so
+// that a steady stream of synchronous sends does not allocate.  The event is
+// used either as a FxSyncRequest's destroyed event or as the event
+// SubmitSync waits on.  In kernel mode a shell used by a FxSyncRequest that
+// has no WDFREQUEST also lends it a preallocated irp.
+//
+#define FX_SYNC_REQUEST_SHELL_SHARDS    (4)
+#define FX_SYNC_REQUEST_SHELL_MAX_DEPTH (8)
+
+struct DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) FxSyncRequestShell : public FxStump {
+    SLIST_ENTRY ListEntry;
+
+    FxCREvent Event;
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    MdIrp Irp;
+
+    CCHAR StackSize;
+#endif
+};
+
+struct DECLSPEC_CACHEALIGN FxSyncRequestShellShard {
+    SLIST_HEADER ListHead;
+
+    volatile LONG Depth;
+};
+
+struct FxSyncRequestShellPool {
+    FxSyncRequestShellShard Shards[FX_SYNC_REQUEST_SHELL_SHARDS];
+};
+
+struct FxIoCompletionRing {
+    volatile LONG Head;
+
+    volatile LONG Tail;
+
+    //
+    // Set while a thread is draining, there is only ever one consumer
+    //
+    volatile LONG Draining;
+
+    ULONG Mask;
+
+    PFN_FX_IO_TARGET_COMPLETION_QUEUE_NOTIFY Notify;
+
+    PVOID NotifyContext;
+
+    FxRequestBase* volatile Slots[1];
+};
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+//
+// Bounce buffers used to double buffer I/O sent to a WdfDeviceIoBuffered
+// target are recycled through a per target cache.  Each size class has one
+// free list per processor shard.  Buffers larger than the largest class are
+// allocated and freed directly.
+//
+#define FX_IO_BOUNCE_BUFFER_CLASSES     (4)
+#define FX_IO_BOUNCE_BUFFER_MAX_SIZE    (4096)
+#define FX_IO_BOUNCE_BUFFER_SHARDS      (4)
+#define FX_IO_BOUNCE_BUFFER_MAX_DEPTH   (4)
+
+struct FxIoBounceBufferList {
+    SLIST_HEADER ListHead;
+
+    volatile LONG Depth;
+};
+
+struct DECLSPEC_CACHEALIGN FxIoBounceBufferShard {
+    FxIoBounceBufferList Classes[FX_IO_BOUNCE_BUFFER_CLASSES];
+};
+
+struct FxIoBounceBufferCache {
+    //
+    // One reference is owned by the FxIoTarget, one by each buffer handed out
+    // from the cache.  The cache is drained and freed on the final release so
+    // that contexts which outlive the target can still return their buffers.
+    //
+    volatile LONG References;
+
+    //
+    // Set when the owning target is destroyed, buffers returned afterwards are
+    // freed instead of being cached.
+    //
+    volatile BOOLEAN Closed;
+
+    FxIoBounceBufferShard Shards[FX_IO_BOUNCE_BUFFER_SHARDS];
+};
+#endif
 
 struct FxIoContext : public FxRequestContext {
 
@@ -63,7 +185,8 @@ struct FxIoContext : public FxRequestContext {
     SetBufferAndLength(
         __in PVOID Buffer,
         __in size_t   BufferLength,
-        __in BOOLEAN CopyBackToBuffer
+        __in BOOLEAN CopyBackToBuffer,
+        __in_opt FxIoBounceBufferCache* BufferCache = NULL
         );
 
     VOID
@@ -89,6 +212,12 @@ public:
     
 #if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
     PVOID m_BufferToFree;
+
+    //
+    // Cache m_BufferToFree is returned to when it is released, NULL if the
+    // buffer was allocated directly from pool.
+    //
+    FxIoBounceBufferCache* m_BufferCache;
     PVOID m_OriginalSystemBuffer;
     PVOID m_OriginalUserBuffer;
     PMDL m_MdlToFree;
@@ -182,6 +311,12 @@ struct FxTargetSubmitSyncParams {
     //
     FxCREvent SynchEvent;
 
+    //
+    // Event actually waited on, either SynchEvent or the event of a pooled
+    // sync request shell.
+    //
+    FxCREvent* Event;
+
     //
     // Status of the request if it was synchronous
     //
@@ -357,12 +492,36 @@ public:
         __in ULONG Flags
         );
 
+    _Must_inspect_result_
+    NTSTATUS
+    EnableCompletionQueue(
+        __in ULONG Capacity,
+        __in_opt PFN_FX_IO_TARGET_COMPLETION_QUEUE_NOTIFY Notify,
+        __in_opt PVOID NotifyContext
+        );
+
+    ULONG
+    DrainCompletionQueue(
+        __in ULONG MaxCount
+        );
+
+    FxSyncRequestShell*
+    AcquireSyncShell(
+        __in BOOLEAN NeedIrp
+        );
+
+    VOID
+    ReleaseSyncShell(
+        __in FxSyncRequestShell* Shell
+        );
+
     _Must_inspect_result_
     NTSTATUS
     SubmitSync(
         __in FxRequestBase* Request,
         __in_opt PWDF_REQUEST_SEND_OPTIONS Options = NULL,
-        __out_opt PULONG Action = NULL
+        __out_opt PULONG Action = NULL,
+        __in_opt FxSyncRequestShell* Shell = NULL
         );
 
     VOID
@@ -487,12 +646,38 @@ public:
         _In_ MdIrp Irp
         );
 
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    static
+    VOID
+    _FreeBounceBuffer(
+        __in_opt FxIoBounceBufferCache* BufferCache,
+        __in PVOID Buffer,
+        __in size_t Length
+        );
+#endif
+
 protected:
     //
     // Hide destructor since we are reference counted object
     //
     ~FxIoTarget();
 
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    _Must_inspect_result_
+    PVOID
+    AllocateBounceBuffer(
+        __in ULONG Length,
+        __out size_t* AllocatedLength,
+        __deref_out_opt FxIoBounceBufferCache** BufferCache
+        );
+
+    static
+    VOID
+    _ReleaseBounceBufferCache(
+        __in FxIoBounceBufferCache* BufferCache
+        );
+#endif
+
     _Must_inspect_result_
     NTSTATUS
     InitModeSpecific(
@@ -608,6 +793,29 @@ protected:
     MdCompletionRoutineType 
     _RequestCompletionRoutine;
 
+    BOOLEAN
+    QueueCompletion(
+        __in FxRequestBase* Request
+        );
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    static
+    VOID
+    _CompletionQueueNotify(
+        __in FxIoTarget* Target,
+        __in PVOID Context
+        );
+
+    static
+    MdDeferredRoutineType
+    _CompletionQueueDpc;
+#endif
+
+    VOID
+    FlushCompletionQueue(
+        VOID
+        );
+
     BOOLEAN
     RemoveCompletedRequestLocked(
         __in FxRequestBase* Request
@@ -946,6 +1154,33 @@ protected:
     //
     UCHAR m_TargetIoType;
 
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    //
+    // Bounce buffer cache for buffered I/O formatted against this target,
+    // allocated on first use.
+    //
+    FxIoBounceBufferCache* volatile m_BounceBufferCache;
+#endif
+
+    //
+    // Completed requests waiting to be drained, NULL unless
+    // EnableCompletionQueue was called.  A queued request stays on the sent
+    // list and holds its m_IoCount reference until it is drained.
+    //
+    FxIoCompletionRing* volatile m_CompletionRing;
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    //
+    // Drains m_CompletionRing when the driver opted in to queued completion
+    //
+    KDPC m_CompletionDpc;
+#endif
+
+    //
+    // Pool of sync request shells, allocated on the first synchronous send
+    //
+    FxSyncRequestShellPool* volatile m_SyncShellPool;
+
     //
     // TRUE if we are in the processing of stopping/purging and there are
     // requests that have been sent and must be waited upon for completion.
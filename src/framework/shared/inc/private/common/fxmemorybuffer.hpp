@@ -49,6 +49,19 @@ public:
         VOID
         );
 
+    virtual
+    USHORT
+    GetFlags(
+        VOID
+        )
+    {
+        //
+        // The buffer is embedded in the object allocation, which is always
+        // made from non paged pool.
+        //
+        return IFxMemoryFlagNonPaged;
+    }
+
     PVOID
     FORCEINLINE
     operator new(
@@ -58,9 +58,19 @@ public:
         )
     {
         m_Pool = MxMemory::MxAllocatePoolWithTag(Type, GetBufferSize(), Tag);
+        m_NonPaged = FxIsPagedPoolType(Type) ? FALSE : TRUE;
         return  m_Pool != NULL ? TRUE : FALSE;
     }
 
+    virtual
+    USHORT
+    GetFlags(
+        VOID
+        )
+    {
+        return m_NonPaged ? IFxMemoryFlagNonPaged : 0;
+    }
+
 protected:
     FxMemoryBufferFromPool(
         __in PFX_DRIVER_GLOBALS FxDriverGlobals,
@@ -71,6 +81,11 @@ protected:
     ~FxMemoryBufferFromPool();
 
     PVOID m_Pool;
+
+    //
+    // TRUE if m_Pool was allocated from a non paged pool type
+    //
+    BOOLEAN m_NonPaged;
 };
 
 class FxMemoryPagedBufferFromPool : public FxMemoryBufferFromPool {
@@ -427,6 +427,11 @@ protected:
         }
     }
 
+    BOOLEAN
+    IsTagTrackerSampled(
+        VOID
+        );
+
     VOID
     AllocateTagTracker(
         __in WDFTYPE Type
@@ -53,6 +53,108 @@ typedef FX_POOL_HEADER* PFX_POOL_HEADER;
 #define FX_POOL_HEADER_SIZE      FIELD_OFFSET(FX_POOL_HEADER, AllocationStart)
 
 
+//
+// Number of non-paged tracker list shards per FX_POOL.  Must be a power of
+// two.  Allocations are linked into the shard of the processor they were
+// made on so that concurrent allocations on different processors do not
+// contend on a single list lock.
+//
+#define FX_POOL_TRACKER_SHARDS      (16)
+
+//
+// Number of distinct pool tags FX_POOL keeps byte/count statistics for.
+// Must be a power of two.  Tags beyond this are only accounted for in the
+// pool-wide totals.
+//
+#define FX_POOL_TAG_STATS_ENTRIES   (32)
+
+struct DECLSPEC_CACHEALIGN FX_POOL_TRACKER_SHARD {
+    MxLockNoDynam       Lock;
+    LIST_ENTRY          Head;
+};
+
+typedef FX_POOL_TRACKER_SHARD *PFX_POOL_TRACKER_SHARD;
+
+//
+// Per tag usage counters.  Updated with interlocked operations only, an
+// entry is claimed by the first allocation that hashes to it.
+//
+struct FX_POOL_TAG_STATS {
+    volatile LONG   Tag;
+    volatile LONG   Allocations;
+    volatile SIZE_T Bytes;
+};
+
+typedef FX_POOL_TAG_STATS *PFX_POOL_TAG_STATS;
+
+//
+// Small allocation cache.
+//
+// When pool tracking is off, NonPagedPool and NonPagedPoolNx allocations made
+// with the driver's own pool tag whose size plus FX_POOL_HEADER_SIZE fits in
+// one of the FX_POOL_CACHE_CLASSES size classes are served from per processor
+// free lists of previously freed blocks of that pool type and class, so
+// steady state object churn (timers, work items, memory objects, I/O
+// contexts, ...) does not hit the system allocator.
+//
+// The header of a cached block always sits at the start of the block, so
+// FX_POOL_HEADER::Base does not need to hold an address.  It instead holds
+// FX_POOL_HEADER_CACHED, which a real pool address never has set, with the
+// pool type and size class index in the bits above it.  FxPoolFree uses this
+// to return the block to its cache.  Nothing here depends on the alignment
+// of the block beyond the low bit being clear.
+//
+#define FX_POOL_CACHE_CLASSES       (6)
+#define FX_POOL_CACHE_TYPES         (2)
+#define FX_POOL_CACHE_MAX_SIZE      (512)
+#define FX_POOL_CACHE_SHARDS        (8)
+#define FX_POOL_CACHE_MAX_DEPTH     (32)
+
+#define FX_POOL_CACHE_TYPE_NX       (1)
+
+#define FX_POOL_HEADER_CACHED       ((ULONG_PTR) 0x1)
+#define FX_POOL_HEADER_TYPE_SHIFT   (1)
+#define FX_POOL_HEADER_TYPE_MASK    ((ULONG_PTR) 0x1)
+#define FX_POOL_HEADER_CLASS_SHIFT  (2)
+#define FX_POOL_HEADER_CLASS_MASK   ((ULONG_PTR) 0x7)
+
+C_ASSERT(FX_POOL_CACHE_TYPES <= FX_POOL_HEADER_TYPE_MASK + 1);
+C_ASSERT(FX_POOL_CACHE_CLASSES <= FX_POOL_HEADER_CLASS_MASK + 1);
+
+struct FX_POOL_CACHE_LIST {
+    SLIST_HEADER    ListHead;
+
+    //
+    // Approximate number of blocks on ListHead
+    //
+    volatile LONG   Depth;
+
+    //
+    // Statistics, traced per size class when the pool is destroyed.  The
+    // share of Hits out of Hits + Misses is the fraction of allocations which
+    // did not reach the system allocator.
+    //
+    volatile LONG   Hits;
+    volatile LONG   Misses;
+    volatile LONG   FreeMisses;
+};
+
+struct DECLSPEC_CACHEALIGN FX_POOL_CACHE_SHARD {
+    FX_POOL_CACHE_LIST Classes[FX_POOL_CACHE_TYPES][FX_POOL_CACHE_CLASSES];
+};
+
+struct FX_POOL_CACHE {
+    //
+    // TRUE if the cache is in use for this pool.  Only set when pool tracking
+    // is off since tracked allocations need their own FX_POOL_TRACKER.
+    //
+    BOOLEAN             Enabled;
+
+    FX_POOL_CACHE_SHARD Shards[FX_POOL_CACHE_SHARDS];
+};
+
+typedef FX_POOL_CACHE *PFX_POOL_CACHE;
+
 //
 // This structure described an indivdually tracked pool.
 //
@@ -61,25 +163,41 @@ typedef FX_POOL_HEADER* PFX_POOL_HEADER;
 //
 
 struct FX_POOL {
-    MxLockNoDynam       NonPagedLock;
-    LIST_ENTRY          NonPagedHead;
+    //
+    // Non-paged trackers, sharded by processor.  The lists are only merged
+    // when dumping the pool for leaks.
+    //
+    FX_POOL_TRACKER_SHARD NonPagedShards[FX_POOL_TRACKER_SHARDS];
 
     MxPagedLockNoDynam  PagedLock;
     LIST_ENTRY          PagedHead;
 
-    // Current Pool Usage Information
-    SIZE_T      NonPagedBytes;
-    SIZE_T      PagedBytes;
+    //
+    // Current Pool Usage Information.  The non-paged counters are maintained
+    // with interlocked operations outside of any lock.
+    //
+    volatile SIZE_T NonPagedBytes;
+    SIZE_T          PagedBytes;
 
-    ULONG       NonPagedAllocations;
-    ULONG       PagedAllocations;
+    volatile LONG   NonPagedAllocations;
+    ULONG           PagedAllocations;
 
-    // Peak Pool Usage Information
+    //
+    // Peak Pool Usage Information.  The non-paged peaks are best effort and
+    // may lag the true peak slightly under concurrent allocation.
+    //
     SIZE_T      PeakNonPagedBytes;
     SIZE_T      PeakPagedBytes;
 
     ULONG       PeakNonPagedAllocations;
     ULONG       PeakPagedAllocations;
+
+    FX_POOL_TAG_STATS TagStats[FX_POOL_TAG_STATS_ENTRIES];
+
+    //
+    // Small non-paged allocation cache, used when tracking is off.
+    //
+    FX_POOL_CACHE Cache;
 };
 
 typedef FX_POOL *PFX_POOL;
@@ -91,16 +209,17 @@ typedef FX_POOL *PFX_POOL;
 // Note: We would be messing up cache aligned if its greater
 //       than 16.
 //
-//       Our struct is 7 DWORD's on an x86, and 11 DWORDS on 64 bit
+//       Our struct is 8 DWORD's on an x86, and 12 DWORDS on 64 bit
 //       machines.
 //
-//       This rounds up to 8 or 12 DWORDS.
+//       Shard shares the padding slot after Tag on 64 bit machines.
 //
 //
 struct DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) FX_POOL_TRACKER {
     LIST_ENTRY Link;
     PFX_POOL   Pool;
     ULONG      Tag;
+    ULONG      Shard;
     SIZE_T     Size;
     POOL_TYPE  PoolType;
     PVOID      CallersAddress;
@@ -75,6 +75,72 @@ FxPoolAddHeaderSize(
     return STATUS_SUCCESS;
 }
 
+VOID
+FORCEINLINE
+FxPoolUpdateTagStats(
+    __in PFX_POOL           Pool,
+    __in ULONG              Tag,
+    __in LONG               Count,
+    __in SIZE_T             Size
+    )
+/*++
+
+Routine Description:
+
+    Adjust the per tag usage counters for Tag.  Lock free; the first
+    allocation of a tag claims an entry in the open addressed table.
+
+Arguments:
+
+    Pool    - Pointer to FX_POOL structure
+
+    Tag     - Pool tag of the allocation
+
+    Count   - +1 on allocate, -1 on free
+
+    Size    - Size in bytes to add (allocate) or subtract (free)
+
+Returns:
+
+    VOID
+
+--*/
+{
+    PFX_POOL_TAG_STATS pStats;
+    ULONG i, index;
+    LONG current;
+
+    if (Tag == 0) {
+        return;
+    }
+
+    index = (Tag ^ (Tag >> 8) ^ (Tag >> 16)) & (FX_POOL_TAG_STATS_ENTRIES - 1);
+
+    for (i = 0; i < FX_POOL_TAG_STATS_ENTRIES; i++) {
+        pStats = &Pool->TagStats[(index + i) & (FX_POOL_TAG_STATS_ENTRIES - 1)];
+
+        current = pStats->Tag;
+        if (current == 0) {
+            current = InterlockedCompareExchange(&pStats->Tag, (LONG) Tag, 0);
+            if (current == 0) {
+                current = (LONG) Tag;
+            }
+        }
+
+        if (current == (LONG) Tag) {
+            InterlockedExchangeAdd(&pStats->Allocations, Count);
+
+            if (Count > 0) {
+                InterlockedExchangeAddSizeT(&pStats->Bytes, Size);
+            }
+            else {
+                InterlockedExchangeAddSizeT(&pStats->Bytes, 0 - Size);
+            }
+            return;
+        }
+    }
+}
+
 VOID
 FORCEINLINE
 FxPoolInsertNonPagedAllocateTracker(
@@ -90,6 +156,9 @@ Routine Description:
 
     Format and insert a Tracker for a NonPaged allocation.
 
+    The tracker is linked into the list shard of the current processor and
+    the pool counters are updated without taking any pool-wide lock.
+
 Arguments:
 
     Pool    - Pointer to FX_POOL structure
@@ -108,30 +177,37 @@ Returns:
 
 --*/
 {
+    PFX_POOL_TRACKER_SHARD pShard;
+    SIZE_T bytes;
+    LONG allocations;
     KIRQL  irql;
 
     Tracker->Tag            = Tag;
+    Tracker->Shard          = Mx::MxGetCurrentProcessorNumber() &
+                                (FX_POOL_TRACKER_SHARDS - 1);
     Tracker->PoolType       = NonPagedPool;
     Tracker->Pool           = Pool;
     Tracker->Size           = Size;
     Tracker->CallersAddress = Caller;
 
-    Pool->NonPagedLock.Acquire(&irql);
+    pShard = &Pool->NonPagedShards[Tracker->Shard];
 
-    InsertTailList(&Pool->NonPagedHead, &Tracker->Link);
+    pShard->Lock.Acquire(&irql);
+    InsertTailList(&pShard->Head, &Tracker->Link);
+    pShard->Lock.Release(irql);
 
-    Pool->NonPagedBytes += Size;
-    Pool->NonPagedAllocations++;
+    bytes = InterlockedExchangeAddSizeT(&Pool->NonPagedBytes, Size) + Size;
+    allocations = InterlockedIncrement(&Pool->NonPagedAllocations);
 
-    if( Pool->NonPagedBytes > Pool->PeakNonPagedBytes ) {
-        Pool->PeakNonPagedBytes = Pool->NonPagedBytes;
+    if( bytes > Pool->PeakNonPagedBytes ) {
+        Pool->PeakNonPagedBytes = bytes;
     }
 
-    if( Pool->NonPagedAllocations > Pool->PeakNonPagedAllocations ) {
-        Pool->PeakNonPagedAllocations = Pool->NonPagedAllocations;
+    if( (ULONG) allocations > Pool->PeakNonPagedAllocations ) {
+        Pool->PeakNonPagedAllocations = (ULONG) allocations;
     }
 
-    Pool->NonPagedLock.Release(irql);
+    FxPoolUpdateTagStats(Pool, Tag, 1, Size);
 }
 
 VOID
@@ -155,16 +231,21 @@ Returns:
 
 --*/
 {
+    PFX_POOL_TRACKER_SHARD pShard;
+    PFX_POOL pPool;
     KIRQL irql;
 
-    Tracker->Pool->NonPagedLock.Acquire(&irql);
+    pPool = Tracker->Pool;
+    pShard = &pPool->NonPagedShards[Tracker->Shard];
 
+    pShard->Lock.Acquire(&irql);
     RemoveEntryList(&Tracker->Link);
+    pShard->Lock.Release(irql);
 
-    Tracker->Pool->NonPagedBytes -= Tracker->Size;
-    Tracker->Pool->NonPagedAllocations--;
+    InterlockedExchangeAddSizeT(&pPool->NonPagedBytes, 0 - Tracker->Size);
+    InterlockedDecrement(&pPool->NonPagedAllocations);
 
-    Tracker->Pool->NonPagedLock.Release(irql);
+    FxPoolUpdateTagStats(pPool, Tracker->Tag, -1, Tracker->Size);
 }
 
 VOID
@@ -222,6 +303,8 @@ Returns:
     }
 
     Pool->PagedLock.Release();
+
+    FxPoolUpdateTagStats(Pool, Tag, 1, Size);
 }
 
 VOID
@@ -253,6 +336,8 @@ Returns:
     Tracker->Pool->PagedAllocations--;
 
     Tracker->Pool->PagedLock.Release();
+
+    FxPoolUpdateTagStats(Tracker->Pool, Tracker->Tag, -1, Tracker->Size);
 }
 
 #endif // __FX_POOL_INLINES_HPP__
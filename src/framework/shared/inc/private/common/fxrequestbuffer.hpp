@@ -81,6 +81,11 @@ public:
                 DataType == FxRequestBufferReferencedMdl) ? TRUE : FALSE;
     }
 
+    BOOLEAN
+    IsNonPagedWritableMemory(
+        VOID
+        );
+
     ULONG
     GetBufferLength(
         VOID
@@ -285,7 +285,8 @@ protected:
         __in USHORT Size,
         __in UCHAR AccessFlags = FxResourceNoAccess
         ) : FxCollection(FxDriverGlobals, Type, Size),
-            m_AccessFlags(AccessFlags), m_Changed(FALSE)
+            m_AccessFlags(AccessFlags), m_Changed(FALSE),
+            m_IndexTable(NULL), m_IndexTableSize(0), m_IndexValid(FALSE)
     {
         //
         // Driver cannot delete this or any of its derivations
@@ -293,6 +294,10 @@ protected:
         MarkNoDeleteDDI();
     }
 
+    ~FxResourceCollection(
+        VOID
+        );
+
 public:
 
     BOOLEAN
@@ -339,10 +344,37 @@ public:
         return m_Changed;
     }
 
+    VOID
+    InvalidateIndex(
+        VOID
+        )
+    {
+        m_IndexValid = FALSE;
+    }
+
+    _Must_inspect_result_
+    FxObject*
+    GetItemIndexedLocked(
+        __in ULONG Index
+        );
+
 public:
     UCHAR m_AccessFlags;
 
     BOOLEAN m_Changed;
+
+protected:
+    //
+    // Array of the collection's objects in list order so that lookups by index
+    // do not walk the list.  Built on the first indexed lookup after the
+    // collection changes shape, it is only grown, never shrunk, and is
+    // guarded by the collection's lock.
+    //
+    FxObject** m_IndexTable;
+
+    ULONG m_IndexTableSize;
+
+    BOOLEAN m_IndexValid;
 };
 
 class FxCmResList : public FxResourceCollection {
@@ -476,6 +508,12 @@ public:
         __in ULONG Index
         );
 
+    PCM_PARTIAL_RESOURCE_DESCRIPTOR
+    GetNextDescriptorOfType(
+        __in UCHAR Type,
+        __inout PULONG Cursor
+        );
+
 #if (FX_CORE_MODE == FX_CORE_USER_MODE)
 
     //
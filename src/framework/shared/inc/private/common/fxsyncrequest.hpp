@@ -40,6 +40,9 @@ Revision History:
 #ifndef _FXSYNCREQUEST_H_
 #define _FXSYNCREQUEST_H_
 
+class FxIoTarget;
+struct FxSyncRequestShell;
+
 class DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) FxSyncRequest : protected FxRequestBase {
 
 public:
@@ -98,6 +101,11 @@ public:
         return STATUS_SUCCESS;
     }
 
+    NTSTATUS
+    Initialize(
+        __in FxIoTarget* Target
+        );
+
     //
     // Since this object can be sitting on a list which is access by another
     // thread and that thread will expect lifetime semantics from AddRef and
@@ -107,6 +115,20 @@ public:
     //
     FxCREvent m_DestroyedEvent;
 
+    //
+    // Event which is set when the last reference is dropped, m_DestroyedEvent
+    // or the event of m_Shell.
+    //
+    FxCREvent* m_Event;
+
+    //
+    // Pooled resources borrowed from m_ShellTarget by Initialize(Target),
+    // returned when this object is destroyed.
+    //
+    FxSyncRequestShell* m_Shell;
+
+    FxIoTarget* m_ShellTarget;
+
     //
     // By default, this will point to this object.  If AssignRequestHandle is
     // called, it will point to the underlying object for that handle.  Since
@@ -104,6 +104,29 @@ struct FxTagTrackingBlock : public FxStump {
         }
     }
 
+    VOID
+    Reinitialize(
+        __in        PVOID Tag,
+        __in        LONG Line,
+        __in_opt    PSTR File
+        )
+    {
+        //
+        // Used when a block is recycled from the owning tracker's free list.
+        // Any StackFrames allocation is kept and overwritten by the caller.
+        //
+        this->Tag = Tag;
+        this->Line = (File == NULL && Line == 0) ? 1 : Line;
+        this->File = File;
+        Next = NULL;
+
+        if (StackFrames != NULL) {
+            StackFrames->NumFrames = 0;
+        }
+
+        Mx::MxQueryTickCount(&TimeLocked);
+    }
+
     struct FxTagTrackingBlock* Next;
     PVOID Tag;
     PCHAR File;
@@ -148,6 +171,12 @@ struct FxTagHistory {
 
 #define TAG_HISTORY_DEPTH (25)
 
+//
+// Number of released tracking blocks each tracker keeps for reuse so that
+// steady-state AddRef/Release pairs do not hit the pool.
+//
+#define TAG_TRACKING_BLOCK_CACHE_DEPTH (4)
+
 class FxTagTracker : public FxGlobalsStump {
 
 private:
@@ -170,7 +199,9 @@ private:
         m_Next(NULL),
         m_FailedCount(0),
         m_CurRefHistory(0),
-        m_OwningObject(Owner)
+        m_OwningObject(Owner),
+        m_FreeBlocks(NULL),
+        m_FreeBlockCount(0)
     {
         RtlZeroMemory(m_TagHistory, sizeof(m_TagHistory));
 
@@ -206,6 +237,18 @@ private:
         }
     }
 
+    FxTagTrackingBlock*
+    PopFreeBlockLocked(
+        __in        PVOID Tag,
+        __in        LONG Line,
+        __in_opt    PSTR File
+        );
+
+    BOOLEAN
+    PushFreeBlockLocked(
+        __in        FxTagTrackingBlock* Block
+        );
+
     VOID
     CopyStackFrames(
         _Inout_ FxTagTrackingStackFrames** StackFrames,
@@ -311,6 +354,14 @@ protected:
     // Current index into RefHistory
     //
     LONG m_CurRefHistory;
+
+    //
+    // Released tracking blocks kept for reuse, guarded by m_SpinLock.  At most
+    // TAG_TRACKING_BLOCK_CACHE_DEPTH blocks are kept.
+    //
+    FxTagTrackingBlock* m_FreeBlocks;
+
+    ULONG m_FreeBlockCount;
 };
 
 #endif // _FXTAGTRACKER_HPP_
@@ -23,6 +23,8 @@ Revision History:
 
 #include "FxUsbRequestContext.hpp"
 
+struct FxUsbConfigIndex;
+
 typedef enum _FX_URB_TYPE : UCHAR {
     FxUrbTypeLegacy,
     FxUrbTypeUsbdAllocated
@@ -625,6 +627,12 @@ protected:
 
     PUSB_CONFIGURATION_DESCRIPTOR m_ConfigDescriptor;
 
+    //
+    // Interfaces, settings and endpoints of m_ConfigDescriptor, built once by
+    // CreateInterfaces
+    //
+    FxUsbConfigIndex* m_ConfigIndex;
+
     USBD_VERSION_INFORMATION m_UsbdVersionInformation;
 
     PUSB_BUSIFFN_QUERY_BUS_TIME m_QueryBusTime;
@@ -406,11 +406,303 @@ public:
     FxUsbPipeRepeatReader m_Readers[1];
 };
 
+struct FxUsbPipeWriteCoalescer;
+
+#define NUM_COALESCED_WRITES_DEFAULT    (2)
+#define NUM_COALESCED_WRITES_MAX        (8)
+
+//
+// Write descriptors preallocated per coalescer.  A deeper backlog falls
+// back to allocating descriptors from pool.
+//
+#define NUM_COALESCED_WRITE_DESCRIPTORS (32)
+
+//
+// Irp DriverContext[] entry holding the FxUsbCoalescedWrite of an irp owned by
+// the coalescer.  Distinct from FX_IRP_QUEUE_CSQ_CONTEXT_ENTRY.
+//
+#define FX_USB_COALESCED_WRITE_CONTEXT_ENTRY    (0)
+
+//
+// A client write accepted by the coalescer.  Its data is copied out of
+// Buffer into merged transfers in the order writes were accepted, and the
+// irp is completed once the transfer holding its last byte completes.
+//
+struct FxUsbCoalescedWrite {
+    //
+    // Links the write into the coalescer's pending or free list
+    //
+    LIST_ENTRY ListEntry;
+
+    FxUsbPipeWriteCoalescer* Parent;
+
+    //
+    // The client's transfer irp.  The coalescer owns it like the driver
+    // below the pipe would: its stack location has been set and its cancel
+    // routine is the coalescer's while the write is cancelable.
+    //
+    MdIrp Irp;
+
+    //
+    // URB formatted in Irp, receives the number of bytes written
+    //
+    _URB_BULK_OR_INTERRUPT_TRANSFER* Urb;
+
+    PVOID Buffer;
+
+    ULONG Length;
+
+    //
+    // Number of bytes already copied into merged transfers
+    //
+    ULONG Copied;
+
+    //
+    // Offset in the write stream one past the write's last byte
+    //
+    ULONGLONG End;
+
+    //
+    // Status to complete the request with, set to the first failure of any
+    // merged transfer the write's data went out in
+    //
+    NTSTATUS Status;
+
+    USBD_STATUS UsbdStatus;
+
+    //
+    // TRUE if the descriptor came from the coalescer's preallocated array
+    //
+    BOOLEAN Preallocated;
+
+    //
+    // TRUE while Request is marked cancelable.  Only writes none of whose
+    // data has been copied yet are cancelable.
+    //
+    BOOLEAN Cancelable;
+};
+
+enum FxUsbWriteBatchState {
+    FxUsbWriteBatchFree = 0,
+    FxUsbWriteBatchSent,
+    FxUsbWriteBatchDone,
+};
+
+//
+// One merged transfer owned by the coalescer
+//
+struct FxUsbWriteBatch {
+    //
+    // Request used to send the merged transfer
+    //
+    FxRequest* Request;
+
+    FxUsbPipeWriteCoalescer* Parent;
+
+    PVOID Buffer;
+
+    ULONG Length;
+
+    //
+    // Offset in the write stream one past the batch's last byte
+    //
+    ULONGLONG End;
+
+    NTSTATUS Status;
+
+    USBD_STATUS UsbdStatus;
+
+    FxUsbWriteBatchState State;
+};
+
+//
+// Merges small writes on a bulk or interrupt OUT pipe into transfers of up
+// to m_TransferSize bytes.  A write is copied into a merged transfer right
+// away when one is free, so a lightly loaded pipe sees no added latency.
+// Once every merged transfer is in flight, new writes queue up and the next
+// transfer to complete is refilled with as many of them as fit, so the
+// busier the pipe the larger the transfers.  Merged transfers are sent and
+// retired in order, and original requests are completed in the order they
+// were accepted.
+//
+// Writes reach the coalescer as formatted transfer irps the pipe would
+// otherwise have sent down, so asynchronous, synchronous and send-and-forget
+// transfers alike keep their place on the pipe's sent list and are stopped,
+// purged and canceled like any other I/O sent to the pipe.
+//
+struct FxUsbPipeWriteCoalescer : public FxStump {
+public:
+    FxUsbPipeWriteCoalescer(
+        __in FxUsbPipe* Pipe,
+        __in UCHAR NumBatches
+        );
+
+    ~FxUsbPipeWriteCoalescer();
+
+    PVOID
+    operator new(
+        __in size_t Size,
+        __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+        __range(1, NUM_COALESCED_WRITES_MAX) ULONG NumBatches
+        );
+
+    _Must_inspect_result_
+    NTSTATUS
+    Config(
+        __in ULONG TransferSize
+        );
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    VOID
+    Write(
+        __in MdIrp Irp,
+        __in _URB_BULK_OR_INTERRUPT_TRANSFER* Urb,
+        __in_bcount(Length) PVOID Buffer,
+        __in ULONG Length
+        );
+#endif
+
+    BOOLEAN
+    IsBatchIrp(
+        __in MdIrp Irp
+        );
+
+protected:
+    VOID
+    Pump(
+        __in FxUsbWriteBatch* Batch,
+        __in NTSTATUS Status,
+        __in USBD_STATUS UsbdStatus
+        );
+
+    VOID
+    PumpAndUnlock(
+        __in __drv_restoresIRQL KIRQL PreviousIrql
+        );
+
+    VOID
+    RemoveUnstagedWriteLocked(
+        __in FxUsbCoalescedWrite* Write
+        );
+
+    VOID
+    FreeWriteLocked(
+        __in FxUsbCoalescedWrite* Write
+        );
+
+    static
+    VOID
+    _CompleteWrite(
+        __in MdIrp Irp,
+        __in _URB_BULK_OR_INTERRUPT_TRANSFER* Urb,
+        __in NTSTATUS Status,
+        __in USBD_STATUS UsbdStatus,
+        __in ULONG Length
+        );
+
+    VOID
+    RetireBatchesLocked(
+        __in PLIST_ENTRY CompletedWrites
+        );
+
+    ULONG
+    FillBatchesLocked(
+        __out_ecount(NUM_COALESCED_WRITES_MAX) FxUsbWriteBatch** Batches
+        );
+
+    _Must_inspect_result_
+    NTSTATUS
+    SendBatch(
+        __in FxUsbWriteBatch* Batch
+        );
+
+    static
+    EVT_WDF_REQUEST_COMPLETION_ROUTINE
+    _FxUsbWriteBatchComplete;
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    static
+    MdCancelRoutineType
+    _FxUsbCoalescedWriteCancel;
+#endif
+
+public:
+    //
+    // The owning pipe
+    //
+    FxUsbPipe* m_Pipe;
+
+    //
+    // Guards everything below
+    //
+    MxLock m_Lock;
+
+    //
+    // Accepted writes which have not been completed yet, in order
+    //
+    LIST_ENTRY m_PendingWrites;
+
+    //
+    // First entry of m_PendingWrites with data left to copy, or
+    // &m_PendingWrites if all data has been copied
+    //
+    PLIST_ENTRY m_StageEntry;
+
+    //
+    // Unused preallocated write descriptors
+    //
+    LIST_ENTRY m_FreeWrites;
+
+    //
+    // Array of NUM_COALESCED_WRITE_DESCRIPTORS write descriptors
+    //
+    FxUsbCoalescedWrite* m_WriteDescriptors;
+
+    //
+    // Bytes accepted so far
+    //
+    ULONGLONG m_StreamOffset;
+
+    //
+    // Bytes copied into merged transfers so far
+    //
+    ULONGLONG m_StagedOffset;
+
+    //
+    // Size of each merged transfer, a multiple of the max packet size
+    //
+    ULONG m_TransferSize;
+
+    //
+    // Oldest batch not yet retired and next batch to fill.  Batches are
+    // filled, sent and retired in ring order.
+    //
+    UCHAR m_Head;
+
+    UCHAR m_Next;
+
+    UCHAR m_NumBatches;
+
+    //
+    // A thread is running Pump; other callers leave their work to it
+    //
+    BOOLEAN m_Pumping;
+
+    BOOLEAN m_PumpRerun;
+
+    //
+    // Open ended array of batches.  MUST be the last element in this
+    // structure.
+    //
+    FxUsbWriteBatch m_Batches[1];
+};
+
 class FxUsbPipe : public FxIoTarget {
 public:
     friend FxUsbDevice;
     friend FxUsbInterface;
     friend FxUsbPipeContinuousReader;
+    friend FxUsbPipeWriteCoalescer;
 
     FxUsbPipe(
         __in PFX_DRIVER_GLOBALS FxDriverGlobals,
@@ -551,6 +843,21 @@ public:
         __in size_t TotalBufferLength
         );
 
+    _Must_inspect_result_
+    NTSTATUS
+    InitWriteCoalescer(
+        __in ULONG NumTransfers,
+        __in ULONG TransferSize
+        );
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    virtual
+    VOID
+    Send(
+        _In_ MdIrp Irp
+        );
+#endif
+
     ULONG
     GetMaxPacketSize(
         VOID
@@ -708,6 +1015,13 @@ protected:
     //
     FxUsbPipeContinuousReader* m_Reader;
 
+    //
+    // If write coalescing has not been turned on for the pipe, this field is
+    // NULL.  It is set in InitPipe, before the pipe is handed to the driver,
+    // and like m_Reader it is cleared in the pipe's Dispose function.
+    //
+    FxUsbPipeWriteCoalescer* m_WriteCoalescer;
+
     //
     // Information about this pipe
     //
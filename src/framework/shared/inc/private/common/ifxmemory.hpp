@@ -33,6 +33,7 @@ Revision History:
 // begin_wpp enum
 enum IFxMemoryFlags {
     IFxMemoryFlagReadOnly = 0x0001,
+    IFxMemoryFlagNonPaged = 0x0002,
 };
 // end_wpp
 
@@ -46,6 +46,19 @@ typedef struct _FxDmaDescription {
 
 } FxDmaDescription;
 
+//
+// Scatter gather list buffers released by transactions are kept on per
+// processor free lists in front of the enabler's lookaside list.
+//
+#define FX_DMA_SGLIST_CACHE_SHARDS      (8)
+#define FX_DMA_SGLIST_CACHE_MAX_DEPTH   (8)
+
+struct DECLSPEC_CACHEALIGN FxDmaSGListCacheShard {
+    SLIST_HEADER ListHead;
+
+    volatile LONG Depth;
+};
+
 enum FxDuplexDmaDescriptionType {
     FxDuplexDmaDescriptionTypeRead = 0,
     FxDuplexDmaDescriptionTypeWrite,
@@ -307,6 +320,26 @@ public:
         return UsesDmaV3() ? DMA_TRANSFER_CONTEXT_SIZE_V1 : 0;
     }
 
+    _Must_inspect_result_
+    PVOID
+    AllocateSGListBuffer(
+        VOID
+        );
+
+    VOID
+    FreeSGListBuffer(
+        __in PVOID Buffer
+        );
+
+    __forceinline
+    FxCommonBufferPool*
+    GetCommonBufferPool(
+        VOID
+        )
+    {
+        return &m_CommonBufferPool;
+    }
+
 public:
     //
     // Link into list of FxDmaEnabler pointers maintained by the pnp package.
@@ -426,6 +459,20 @@ protected:
 
     } m_SGList;
 
+    //
+    // Per processor cache of m_SGListSize buffers in front of the lookaside
+    // list of the scatter gather profile, FX_DMA_SGLIST_CACHE_SHARDS entries.
+    // Allocated from cache aligned pool along with the lookaside list since
+    // the enabler itself is not cache aligned.
+    //
+    FxDmaSGListCacheShard*  m_SGListCache;
+
+    //
+    // Slabs small common buffers created against this enabler are carved
+    // from.
+    //
+    FxCommonBufferPool      m_CommonBufferPool;
+
 private:
     //
     // Power-related callbacks.
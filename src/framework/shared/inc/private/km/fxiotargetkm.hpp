@@ -36,6 +36,7 @@ FxIoContext::FxIoContext(
     m_MdlToFree(NULL),
     m_OriginalMdl(NULL),
     m_BufferToFree(NULL),
+    m_BufferCache(NULL),
     m_OriginalSystemBuffer(NULL),
     m_OriginalUserBuffer(NULL),
     m_OtherMemory(NULL),
@@ -137,8 +138,11 @@ FxIoContext::ClearBuffer(
     )
 {
     if (m_BufferToFree != NULL) {
-        FxPoolFree(m_BufferToFree);
+        FxIoTarget::_FreeBounceBuffer(m_BufferCache,
+                                      m_BufferToFree,
+                                      m_BufferToFreeLength);
         m_BufferToFree = NULL;
+        m_BufferCache = NULL;
     }
     
     m_BufferToFreeLength = 0;
@@ -215,18 +219,25 @@ VOID
 FxIoContext::SetBufferAndLength(
     __in PVOID Buffer,
     __in size_t   BufferLength,
-    __in BOOLEAN CopyBackToBuffer
+    __in BOOLEAN CopyBackToBuffer,
+    __in_opt FxIoBounceBufferCache* BufferCache
     )
 {
+    FxIoBounceBufferCache* pOldCache;
     PVOID pOldBuffer;
+    size_t oldLength;
 
     pOldBuffer = m_BufferToFree;
+    pOldCache = m_BufferCache;
+    oldLength = m_BufferToFreeLength;
+
     m_BufferToFree = Buffer;
+    m_BufferCache = BufferCache;
     m_BufferToFreeLength = BufferLength;
     m_CopyBackToBuffer = CopyBackToBuffer;
 
     if (pOldBuffer != NULL) {
-        FxPoolFree(pOldBuffer);
+        FxIoTarget::_FreeBounceBuffer(pOldCache, pOldBuffer, oldLength);
     }
 }
 
@@ -240,7 +251,26 @@ FxIoTarget::InitModeSpecific(
 {
     UNREFERENCED_PARAMETER(Device);
 
-    DO_NOTHING();
+    //
+    // Drivers which opted in (IoTargetCompletionQueueOn under Parameters\Wdf)
+    // get asynchronous completions queued by the irp completion routine and
+    // delivered in batches from a DPC.  Without the queue completions are
+    // simply delivered inline, so failing to set it up is not fatal.
+    //
+    // Only plain and remote targets queue.  USB pipes run continuous readers
+    // and coalesced writes whose own completion routines resubmit, and
+    // together with the self target they are stopped and purged on paths
+    // which expect completions to have been delivered inline.
+    //
+    if (GetDriverGlobals()->FxIoTargetCompletionQueueOn &&
+        (GetType() == FX_TYPE_IO_TARGET ||
+         GetType() == FX_TYPE_IO_TARGET_REMOTE)) {
+        KeInitializeDpc(&m_CompletionDpc, _CompletionQueueDpc, this);
+
+        (VOID) EnableCompletionQueue(FX_IO_COMPLETION_QUEUE_CAPACITY,
+                                     _CompletionQueueNotify,
+                                     NULL);
+    }
 
     return STATUS_SUCCESS;
 }
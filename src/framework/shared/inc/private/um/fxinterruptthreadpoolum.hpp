@@ -26,8 +26,58 @@ Revision History:
 #pragma once
     
 #define MINIMUM_THREAD_COUNT_DEFAULT   (1)
+
+//
+// Bounds, in microseconds, of the adaptive spin done by the interrupt's
+// threadpool callback before it parks on the interrupt event again.  The
+// spin starts at the minimum, doubles each time an interrupt arrives while
+// spinning and halves each time the spin runs out, never exceeding the
+// maximum configured for the interrupt.
+//
+#define FX_INTERRUPT_SPIN_MIN_US       (2)
+#define FX_INTERRUPT_SPIN_MAX_US       (200)
+
 class FxInterrupt;
 
+//
+// Per-interrupt delivery counters, only kept while spin delivery is on and
+// traced each time the interrupt is disconnected.  Times are in
+// QueryPerformanceCounter ticks.  Only the interrupt's threadpool callback
+// and its work item update them, and never concurrently with themselves, so
+// no locking is used; readers may see a torn snapshot.
+//
+// The counters only describe the spinning side.  The latency without spin
+// delivery has to be taken from an ETW trace of the reflector signaling the
+// interrupt event and the driver's EvtInterruptIsr running.
+//
+struct FxInterruptDeliveryCounters {
+    //
+    // ISR invocations, and how many of them were picked up while spinning
+    // instead of by a threadpool wait callback.
+    //
+    ULONGLONG Interrupts;
+    ULONGLONG SpinDeliveries;
+
+    //
+    // Spins which ran out without an interrupt arriving
+    //
+    ULONGLONG SpinTimeouts;
+
+    //
+    // Time spent in the ISR callback
+    //
+    ULONGLONG IsrTicksTotal;
+    ULONGLONG IsrTicksMax;
+
+    //
+    // Time from queueing the work item for the ISR until EvtInterruptDpc or
+    // EvtInterruptWorkItem is called
+    //
+    ULONGLONG DpcCount;
+    ULONGLONG DpcLatencyTicksTotal;
+    ULONGLONG DpcLatencyTicksMax;
+};
+
 class FxInterruptThreadpool  : FxGlobalsStump
 {
 
@@ -106,6 +156,22 @@ private:
     //
     HANDLE m_Event;
 
+    //
+    // Adaptive spin bounds and current budget, in performance counter ticks.
+    // m_SpinMaxTicks is zero when spin delivery is off.
+    //
+    LONGLONG m_SpinMinTicks;
+    LONGLONG m_SpinMaxTicks;
+    LONGLONG m_SpinTicks;
+
+    //
+    // Performance counter value when the work item for the ISR was queued,
+    // zero when no work item is pending.
+    //
+    volatile LONGLONG m_DpcQueuedTime;
+
+    FxInterruptDeliveryCounters m_Counters;
+
 
     HRESULT
     Initialize(
@@ -130,8 +196,13 @@ public:
         ) :
         FxGlobalsStump(FxDriverGlobals),
         m_Wait(NULL),
-        m_Event(NULL)
+        m_Event(NULL),
+        m_SpinMinTicks(0),
+        m_SpinMaxTicks(0),
+        m_SpinTicks(0),
+        m_DpcQueuedTime(0)
     {
+        RtlZeroMemory(&m_Counters, sizeof(m_Counters));
     }
 
     ~FxInterruptWaitblock();
@@ -191,5 +262,56 @@ public:
         ::ResetEvent(m_Event);
     }
 
+    VOID
+    SetSpinDelivery(
+        _In_ ULONG MaxSpinMicroseconds
+        );
+
+    BOOLEAN
+    IsSpinDeliveryEnabled(
+        VOID
+        )
+    {
+        return m_SpinMaxTicks != 0 ? TRUE : FALSE;
+    }
+
+    BOOLEAN
+    SpinForEvent(
+        VOID
+        );
+
+    VOID
+    RecordIsrTime(
+        _In_ LONGLONG IsrTicks,
+        _In_ BOOLEAN FromSpin
+        )
+    {
+        m_Counters.Interrupts++;
+
+        if (FromSpin) {
+            m_Counters.SpinDeliveries++;
+        }
+
+        m_Counters.IsrTicksTotal += IsrTicks;
+        if ((ULONGLONG) IsrTicks > m_Counters.IsrTicksMax) {
+            m_Counters.IsrTicksMax = IsrTicks;
+        }
+    }
+
+    VOID
+    RecordDpcQueued(
+        VOID
+        );
+
+    VOID
+    RecordDpcStarted(
+        VOID
+        );
+
+    VOID
+    TraceCounters(
+        VOID
+        );
+
 };
 
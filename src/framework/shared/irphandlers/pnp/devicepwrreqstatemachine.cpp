@@ -137,6 +137,7 @@ FxDevicePwrRequirementMachine::ProcessEvent(
     NTSTATUS status;
     KIRQL irql;
     LONGLONG timeout = 0;
+    BOOLEAN queueWorkItem;
  
     //
     // Acquire state machine *queue* lock, raising to DISPATCH_LEVEL
@@ -182,6 +183,15 @@ FxDevicePwrRequirementMachine::ProcessEvent(
     //
     m_Queue[InsertAtTail()] = Event;
 
+    //
+    // Above PASSIVE_LEVEL the event cannot be processed on this thread, so
+    // claim the work item while we still hold the *queue* lock.
+    //
+    queueWorkItem = FALSE;
+    if (irql != PASSIVE_LEVEL) {
+        queueWorkItem = ClaimWorkItemLocked();
+    }
+
     //
     // Drop the state machine *queue* lock
     //
@@ -225,6 +235,16 @@ FxDevicePwrRequirementMachine::ProcessEvent(
             return;
         }
     }
+    else {
+        //
+        // If the claim failed, the work item is already queued and will pick
+        // up our event.
+        //
+        if (queueWorkItem) {
+            QueueClaimedWorkItem();
+        }
+        return;
+    }
     
     //
     // For one reason or another, we couldn't run the state machine on this
@@ -1839,6 +1839,11 @@ FxInterrupt::QueueWorkItemForIsr(
 #endif
     }
     else {
+#if ((FX_CORE_MODE)==(FX_CORE_USER_MODE))
+        if (m_InterruptWaitblock->IsSpinDeliveryEnabled()) {
+            m_InterruptWaitblock->RecordDpcQueued();
+        }
+#endif
         queued = m_SystemWorkItem->TryToEnqueue(_InterruptWorkItemCallback, this);
     }
 
@@ -39,6 +39,7 @@ typedef EVT_SYSTEMWORKITEM *PFN_WDF_SYSTEMWORKITEM;
 #include "FxPkgIo.hpp"
 #include "FxIoQueue.hpp"
 
+#include "FxCommonBufferPool.hpp"
 #include "FxDmaEnabler.hpp"
 #include "FxSystemWorkItem.hpp"
 
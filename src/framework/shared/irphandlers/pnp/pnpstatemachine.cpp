@@ -840,6 +840,7 @@ Return Value:
 {
     NTSTATUS status;
     KIRQL oldIrql;
+    BOOLEAN differentThread, queueWorkItem;
 
     //
     // Take the lock, raising to DISPATCH_LEVEL.
@@ -901,6 +902,20 @@ Return Value:
         m_PnpMachine.m_Queue[m_PnpMachine.InsertAtTail()] = Event;
     }
 
+    //
+    // If the event cannot be processed on this thread, claim the work item
+    // while we still hold the lock instead of reacquiring it in QueueToThread.
+    //
+    differentThread = ShouldProcessPnpEventOnDifferentThread(
+        oldIrql,
+        ProcessOnDifferentThread
+        );
+
+    queueWorkItem = FALSE;
+    if (differentThread) {
+        queueWorkItem = m_PnpMachine.ClaimWorkItemLocked();
+    }
+
     //
     // Drop the lock.
     //
@@ -911,10 +926,7 @@ Return Value:
     // machine on this thread.  If we can't do that, then queue a work item.
     //
 
-    if (FALSE == ShouldProcessPnpEventOnDifferentThread(
-                    oldIrql,
-                    ProcessOnDifferentThread
-                    )) {
+    if (FALSE == differentThread) {
 
         LONGLONG timeout = 0;
 
@@ -936,6 +948,16 @@ Return Value:
             return;
         }
     }
+    else {
+        //
+        // If the claim failed, the work item is already queued and will pick
+        // up our event.
+        //
+        if (queueWorkItem) {
+            m_PnpMachine.QueueClaimedWorkItem();
+        }
+        return;
+    }
 
     //
     // For one reason or another, we couldn't run the state machine on this
@@ -2904,6 +2904,7 @@ Return Value:
     NTSTATUS status;
     ULONG mask;
     KIRQL irql;
+    BOOLEAN differentThread, queueWorkItem;
 
     //
     // Take the lock, raising to DISPATCH_LEVEL.
@@ -2987,6 +2988,20 @@ Return Value:
         m_PowerPolicyMachine.m_Queue[m_PowerPolicyMachine.InsertAtTail()] = Event;
     }
 
+    //
+    // If the event cannot be processed on this thread, claim the work item
+    // while we still hold the lock instead of reacquiring it in QueueToThread.
+    //
+    differentThread = ShouldProcessPowerPolicyEventOnDifferentThread(
+        irql,
+        ProcessOnDifferentThread
+        );
+
+    queueWorkItem = FALSE;
+    if (differentThread) {
+        queueWorkItem = m_PowerPolicyMachine.ClaimWorkItemLocked();
+    }
+
     //
     // Drop the lock.
     //
@@ -2996,10 +3011,7 @@ Return Value:
     // Now, if we are running at PASSIVE_LEVEL, attempt to run the state
     // machine on this thread.  If we can't do that, then queue a work item.
     //
-    if (FALSE == ShouldProcessPowerPolicyEventOnDifferentThread(
-                    irql,
-                    ProcessOnDifferentThread
-                    )) {
+    if (FALSE == differentThread) {
 
         LONGLONG timeout = 0;
 
@@ -3028,6 +3040,16 @@ Return Value:
             return;
         }
     }
+    else {
+        //
+        // If the claim failed, the work item is already queued and will pick
+        // up our event.
+        //
+        if (queueWorkItem) {
+            m_PowerPolicyMachine.QueueClaimedWorkItem();
+        }
+        return;
+    }
 
     //
     // The tag added above will be released when the work item runs
@@ -1172,6 +1172,7 @@ Return Value:
 {
     NTSTATUS status;
     KIRQL irql;
+    BOOLEAN queueWorkItem;
 
     //
     // Take the lock, raising to DISPATCH_LEVEL.
@@ -1248,6 +1249,15 @@ Return Value:
         m_PowerMachine.m_Queue.Events[m_PowerMachine.InsertAtTail()] = (USHORT) Event;
     }
 
+    //
+    // Above PASSIVE_LEVEL the event cannot be processed on this thread, so
+    // claim the work item while we still hold the lock.
+    //
+    queueWorkItem = FALSE;
+    if (irql != PASSIVE_LEVEL) {
+        queueWorkItem = m_PowerMachine.ClaimWorkItemLocked();
+    }
+
     //
     // Drop the lock.
     //
@@ -1285,6 +1295,16 @@ Return Value:
             return;
         }
     }
+    else {
+        //
+        // If the claim failed, the work item is already queued and will pick
+        // up our event.
+        //
+        if (queueWorkItem) {
+            m_PowerMachine.QueueClaimedWorkItem();
+        }
+        return;
+    }
 
     //
     // The tag added above will be released when the work item runs
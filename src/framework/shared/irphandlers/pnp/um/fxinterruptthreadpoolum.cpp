@@ -398,3 +398,194 @@ exit:
 }
 
 
+
+VOID
+FxInterruptWaitblock::SetSpinDelivery(
+    _In_ ULONG MaxSpinMicroseconds
+    )
+/*++
+
+Routine Description:
+    Turns spin delivery on or off.  When on, the threadpool callback polls
+    the interrupt event for a while after servicing an interrupt before it
+    re-registers the wait, so that interrupts arriving back to back are
+    serviced on the same thread without a wake up and a new callback.
+
+    Must be called while the interrupt is disconnected.
+
+Arguments:
+    MaxSpinMicroseconds - upper bound of the adaptive spin, zero turns spin
+        delivery off
+
+  --*/
+{
+    LARGE_INTEGER frequency;
+
+    if (MaxSpinMicroseconds == 0) {
+        m_SpinMinTicks = 0;
+        m_SpinMaxTicks = 0;
+        m_SpinTicks = 0;
+        return;
+    }
+
+    if (MaxSpinMicroseconds < FX_INTERRUPT_SPIN_MIN_US) {
+        MaxSpinMicroseconds = FX_INTERRUPT_SPIN_MIN_US;
+    }
+    else if (MaxSpinMicroseconds > FX_INTERRUPT_SPIN_MAX_US) {
+        MaxSpinMicroseconds = FX_INTERRUPT_SPIN_MAX_US;
+    }
+
+    //
+    // Never fails on XP and later
+    //
+    (VOID) QueryPerformanceFrequency(&frequency);
+
+    m_SpinMinTicks = (frequency.QuadPart * FX_INTERRUPT_SPIN_MIN_US) / 1000000;
+    m_SpinMaxTicks = (frequency.QuadPart * MaxSpinMicroseconds) / 1000000;
+
+    if (m_SpinMinTicks == 0) {
+        m_SpinMinTicks = 1;
+    }
+    if (m_SpinMaxTicks < m_SpinMinTicks) {
+        m_SpinMaxTicks = m_SpinMinTicks;
+    }
+
+    m_SpinTicks = m_SpinMinTicks;
+
+    //
+    // Counters are not kept while spin delivery is off, start them afresh.
+    //
+    m_DpcQueuedTime = 0;
+    RtlZeroMemory(&m_Counters, sizeof(m_Counters));
+
+    DoTraceLevelMessage(GetDriverGlobals(), 
+                TRACE_LEVEL_INFORMATION, TRACINGPNP,
+                "Interrupt spin delivery enabled, spinning up to %d us",
+                MaxSpinMicroseconds);
+}
+
+BOOLEAN
+FxInterruptWaitblock::SpinForEvent(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Polls the interrupt event for up to the current spin budget.  Consumes
+    the signal if the event becomes signalled.  The budget doubles when an
+    interrupt arrives while spinning and halves when it does not, within the
+    bounds set by SetSpinDelivery, so a device whose interrupts are sparse
+    quickly goes back to parking on the event.
+
+Return Value:
+    TRUE if the event was signalled and the interrupt should be serviced on
+    this thread, FALSE if the caller should re-register the wait
+
+  --*/
+{
+    LARGE_INTEGER start, now;
+    ULONG i;
+
+    QueryPerformanceCounter(&start);
+
+    for (;;) {
+        if (WaitForSingleObject(m_Event, 0) == WAIT_OBJECT_0) {
+            m_SpinTicks = min(m_SpinTicks * 2, m_SpinMaxTicks);
+            return TRUE;
+        }
+
+        //
+        // Each poll is a system call, so back off a little between polls
+        //
+        for (i = 0; i < 64; i++) {
+            YieldProcessor();
+        }
+
+        QueryPerformanceCounter(&now);
+
+        if (now.QuadPart - start.QuadPart >= m_SpinTicks) {
+            break;
+        }
+    }
+
+    m_Counters.SpinTimeouts++;
+    m_SpinTicks = max(m_SpinTicks / 2, m_SpinMinTicks);
+
+    return FALSE;
+}
+
+VOID
+FxInterruptWaitblock::RecordDpcQueued(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Records when the work item for the ISR is about to be queued.  If a work
+    item is already pending its time is kept, since that is the one which
+    will run next.
+
+  --*/
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+
+    (VOID) InterlockedCompareExchange64(&m_DpcQueuedTime, now.QuadPart, 0);
+}
+
+VOID
+FxInterruptWaitblock::RecordDpcStarted(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Called by the work item for the ISR before it invokes the driver.
+    Accounts the time since RecordDpcQueued.
+
+  --*/
+{
+    LARGE_INTEGER now;
+    LONGLONG queued;
+    ULONGLONG latency;
+
+    queued = InterlockedExchange64(&m_DpcQueuedTime, 0);
+    if (queued == 0) {
+        return;
+    }
+
+    QueryPerformanceCounter(&now);
+
+    latency = (ULONGLONG) (now.QuadPart - queued);
+
+    m_Counters.DpcCount++;
+    m_Counters.DpcLatencyTicksTotal += latency;
+    if (latency > m_Counters.DpcLatencyTicksMax) {
+        m_Counters.DpcLatencyTicksMax = latency;
+    }
+}
+
+VOID
+FxInterruptWaitblock::TraceCounters(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Logs the delivery counters.  Called once the interrupt is disconnected
+    and its threadpool callback and work item have been flushed.
+
+  --*/
+{
+    DoTraceLevelMessage(GetDriverGlobals(), 
+                TRACE_LEVEL_VERBOSE, TRACINGPNP,
+                "Interrupt delivery: ISRs %I64u (%I64u while spinning), "
+                "spin timeouts %I64u, ISR ticks total %I64u max %I64u, "
+                "DPCs %I64u, DPC latency ticks total %I64u max %I64u",
+                m_Counters.Interrupts, m_Counters.SpinDeliveries,
+                m_Counters.SpinTimeouts, m_Counters.IsrTicksTotal,
+                m_Counters.IsrTicksMax, m_Counters.DpcCount,
+                m_Counters.DpcLatencyTicksTotal,
+                m_Counters.DpcLatencyTicksMax);
+}
@@ -106,6 +106,15 @@ FxInterrupt::InitializeInternal(
         goto exit;
     }
 
+    //
+    // Drivers opt in to spin delivery through InterruptSpinDeliveryMaxUs under
+    // their Parameters\Wdf key.
+    //
+    if (GetDriverGlobals()->FxInterruptSpinDeliveryMaxUs != 0) {
+        m_InterruptWaitblock->SetSpinDelivery(
+            GetDriverGlobals()->FxInterruptSpinDeliveryMaxUs);
+    }
+
     //
     // Send an IOCTL to redirector to create and initialize an interrupt object
     //
@@ -270,6 +279,10 @@ FxInterrupt::DisconnectInternal(
     //
     FlushQueuedWorkitem();
 
+    if (m_InterruptWaitblock->IsSpinDeliveryEnabled()) {
+        m_InterruptWaitblock->TraceCounters();
+    }
+
     return;
 }
 
@@ -513,12 +526,14 @@ FxInterrupt::AssignResourcesInternal(
 
 }
 
-VOID
-FxInterrupt::ThreadpoolWaitCallback(
-    VOID
+BOOLEAN
+FxInterrupt::InvokeThreadpoolIsr(
+    __in BOOLEAN FromSpin
     )
 {
     BOOLEAN claimed;
+    BOOLEAN counted;
+    LARGE_INTEGER start, end;
 
     // 
     // ETW event for performance measurement
@@ -527,6 +542,15 @@ FxInterrupt::ThreadpoolWaitCallback(
         m_InterruptInfo.MessageNumber
         );
 
+    //
+    // Delivery counters are only kept for interrupts which opted in to spin
+    // delivery, everyone else does not pay for the timestamps.
+    //
+    counted = m_InterruptWaitblock->IsSpinDeliveryEnabled();
+    if (counted) {
+        QueryPerformanceCounter(&start);
+    }
+
     //
     // Invoke the ISR callback under interrupt lock.
     //
@@ -545,6 +569,50 @@ FxInterrupt::ThreadpoolWaitCallback(
         ReleaseLock();
     }                   
 
+    if (counted) {
+        QueryPerformanceCounter(&end);
+
+        m_InterruptWaitblock->RecordIsrTime(end.QuadPart - start.QuadPart,
+                                            FromSpin);
+    }
+
+    return claimed;
+}
+
+VOID
+FxInterrupt::ThreadpoolWaitCallback(
+    VOID
+    )
+{
+    BOOLEAN claimed;
+
+    claimed = InvokeThreadpoolIsr(FALSE);
+
+    if (m_InterruptWaitblock->IsSpinDeliveryEnabled()) {
+        //
+        // Keep servicing interrupts on this thread for as long as they keep
+        // arriving within the spin budget.  The reflector must have the
+        // acknowledgement before it can signal the next level triggered
+        // interrupt, so acknowledge before spinning.
+        //
+        for (;;) {
+            AcknowledgeThreadpoolInterrupt(claimed);
+
+            if (m_CanQueue == FALSE ||
+                m_InterruptWaitblock->SpinForEvent() == FALSE) {
+                break;
+            }
+
+            claimed = InvokeThreadpoolIsr(TRUE);
+        }
+
+        if (m_CanQueue) {
+            QueueSingleWaitOnInterruptEvent();
+        }
+
+        return;
+    }
+
     //
     // Queue another wait. MSDN: You must re-register the event with the
     // wait object before signaling it each time to trigger the wait callback.
@@ -553,6 +621,14 @@ FxInterrupt::ThreadpoolWaitCallback(
         QueueSingleWaitOnInterruptEvent();
     }
 
+    AcknowledgeThreadpoolInterrupt(claimed);
+}
+
+VOID
+FxInterrupt::AcknowledgeThreadpoolInterrupt(
+    __in BOOLEAN Claimed
+    )
+{
     //
     // Return acknowledgement to reflector if it's handled at passive level 
     // by reflector.
@@ -563,7 +639,7 @@ FxInterrupt::ThreadpoolWaitCallback(
 
         deviceStack = m_Device->GetDeviceStack();
         
-        hr = deviceStack->AcknowledgeInterrupt(m_RdInterruptContext, claimed);
+        hr = deviceStack->AcknowledgeInterrupt(m_RdInterruptContext, Claimed);
         
         if (FAILED(hr)) {
             DoTraceLevelMessage(GetDriverGlobals(), 
@@ -729,6 +805,10 @@ FxInterrupt::WorkItemHandler(
     
     FX_TRACK_DRIVER(GetDriverGlobals());
 
+    if (m_InterruptWaitblock->IsSpinDeliveryEnabled()) {
+        m_InterruptWaitblock->RecordDpcStarted();
+    }
+
     //
     // Call the drivers registered WorkItemForIsr event callback
     //
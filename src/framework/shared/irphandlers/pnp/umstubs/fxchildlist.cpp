@@ -124,6 +124,13 @@ FxChildList::FxChildList(
 {
     UfxVerifierTrapNotImpl();
 }
+
+FxChildList::~FxChildList(
+    VOID
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
     
 BOOLEAN
 FxChildList::Dispose(
@@ -435,6 +442,84 @@ FxChildList::DrainFreeListHead(
     UfxVerifierTrapNotImpl();
 }
 
+VOID
+FxChildList::InsertDescriptionLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+VOID
+FxChildList::RemoveDescriptionLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+VOID
+FxChildList::InsertModificationLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+VOID
+FxChildList::RemoveModificationLocked(
+    __inout FxDeviceDescriptionEntry* Entry
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+ULONG
+FxChildList::HashId(
+    __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
+    )
+{
+    UfxVerifierTrapNotImpl();
+    return 0;
+}
+
+VOID
+FxChildList::IndexInsertLocked(
+    __inout FxDeviceDescriptionEntry* Entry,
+    __in FxChildListIteratorIndexValues Index
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+VOID
+FxChildList::IndexRemoveLocked(
+    __inout FxDeviceDescriptionEntry* Entry,
+    __in FxChildListIteratorIndexValues Index
+    )
+{
+    UfxVerifierTrapNotImpl();
+}
+
+BOOLEAN
+FxChildList::RebuildIndexLocked(
+    __in FxChildListIteratorIndexValues Index
+    )
+{
+    UfxVerifierTrapNotImpl();
+    return FALSE;
+}
+
+FxDeviceDescriptionEntry*
+FxChildList::IndexLookupLocked(
+    __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id,
+    __in FxChildListIteratorIndexValues Index
+    )
+{
+    UfxVerifierTrapNotImpl();
+    return NULL;
+}
+
 FxDeviceDescriptionEntry*
 FxChildList::SearchBackwardsForMatchingModificationLocked(
     __in PWDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER Id
@@ -493,6 +578,16 @@ FxChildList::ProcessBusRelations(
     return STATUS_NOT_IMPLEMENTED;
 }
 
+BOOLEAN
+FxChildList::UpdateRelationsSnapshot(
+    __in_opt PDEVICE_RELATIONS Relations,
+    __in ULONG FirstObject
+    )
+{
+    UfxVerifierTrapNotImpl();
+    return FALSE;
+}
+
 VOID
 FxChildList::InvokeReportedMissingCallback(
     VOID
@@ -123,6 +123,7 @@ FxWakeInterruptMachine::ProcessEvent(
     NTSTATUS status;
     KIRQL irql;
     LONGLONG timeout = 0;
+    BOOLEAN queueWorkItem;
  
     //
     // Acquire state machine *queue* lock, raising to DISPATCH_LEVEL
@@ -168,6 +169,15 @@ FxWakeInterruptMachine::ProcessEvent(
     //
     m_Queue[InsertAtTail()] = Event;
 
+    //
+    // Above PASSIVE_LEVEL the event cannot be processed on this thread, so
+    // claim the work item while we still hold the *queue* lock.
+    //
+    queueWorkItem = FALSE;
+    if (irql != PASSIVE_LEVEL) {
+        queueWorkItem = ClaimWorkItemLocked();
+    }
+
     //
     // Drop the state machine *queue* lock
     //
@@ -211,6 +221,16 @@ FxWakeInterruptMachine::ProcessEvent(
             return;
         }
     }
+    else {
+        //
+        // If the claim failed, the work item is already queued and will pick
+        // up our event.
+        //
+        if (queueWorkItem) {
+            QueueClaimedWorkItem();
+        }
+        return;
+    }
     
     //
     // For one reason or another, we couldn't run the state machine on this
@@ -269,6 +269,37 @@ FxObject::QueryInterface(
     return status;
 }
 
+BOOLEAN
+FxObject::IsTagTrackerSampled(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Decides whether this object is one of the objects picked for reference
+    tracking when the driver has configured TrackHandlesSampleRate.  Objects
+    which are not sampled take no tag tracker and their AddRef/Release calls
+    stay on the fast path.
+
+Return Value:
+    TRUE if a tag tracker should be allocated for this object
+
+--*/
+{
+    FxDriverGlobalsDebugExtension* pExtension;
+    ULONG count;
+
+    pExtension = m_Globals->DebugExtension;
+
+    if (pExtension->TrackHandlesSampleRate <= 1) {
+        return TRUE;
+    }
+
+    count = (ULONG) InterlockedIncrement(&pExtension->TrackHandlesSampleCounter);
+
+    return (count % pExtension->TrackHandlesSampleRate) == 1 ? TRUE : FALSE;
+}
+
 VOID
 FxObject::AllocateTagTracker(
     __in WDFTYPE Type
@@ -280,7 +311,8 @@ FxObject::AllocateTagTracker(
         m_Globals->DebugExtension->ObjectDebugInfo != NULL &&
         FxVerifierGetTrackReferences(
             m_Globals->DebugExtension->ObjectDebugInfo,
-            Type)) {
+            Type) &&
+        IsTagTrackerSampled()) {
         //
         // Failure to CreateAndInitialize a tag tracker is no big deal, we just 
         // don't track references.
@@ -98,9 +98,76 @@ Return Value:
         current = next;
     }
 
+    current = m_FreeBlocks;
+    m_FreeBlocks = NULL;
+    m_FreeBlockCount = 0;
+
+    while (current != NULL) {
+        next = current->Next;
+        delete current;
+        current = next;
+    }
+
     m_SpinLock.Release(irql);
 }
 
+FxTagTrackingBlock*
+FxTagTracker::PopFreeBlockLocked(
+    __in        PVOID Tag,
+    __in        LONG Line,
+    __in_opt    PSTR File
+    )
+/*++
+
+Routine Description:
+    Returns a previously released tracking block of this tracker, initialized
+    for a new reference.  The caller must hold m_SpinLock.
+
+Return Value:
+    The block, or NULL if no released block is cached
+
+--*/
+{
+    FxTagTrackingBlock* pBlock;
+
+    pBlock = m_FreeBlocks;
+    if (pBlock != NULL) {
+        m_FreeBlocks = pBlock->Next;
+        m_FreeBlockCount--;
+
+        pBlock->Reinitialize(Tag, Line, File);
+    }
+
+    return pBlock;
+}
+
+BOOLEAN
+FxTagTracker::PushFreeBlockLocked(
+    __in        FxTagTrackingBlock* Block
+    )
+/*++
+
+Routine Description:
+    Caches a released tracking block for reuse.  The caller must hold
+    m_SpinLock.
+
+Return Value:
+    TRUE if the block was cached, FALSE if the cache is full and the caller
+    must delete the block once the lock is dropped
+
+--*/
+{
+    if (m_FreeBlockCount >= TAG_TRACKING_BLOCK_CACHE_DEPTH) {
+        return FALSE;
+    }
+
+    Block->Next = m_FreeBlocks;
+    m_FreeBlocks = Block;
+    m_FreeBlockCount++;
+
+    return TRUE;
+}
+
 VOID
 FxTagTracker::CopyStackFrames(
     _Inout_ FxTagTrackingStackFrames** StackFrames,
@@ -167,6 +234,7 @@ Return Value:
     PFX_DRIVER_GLOBALS pFxDriverGlobals;
     FxTagHistory* pTagHistory;
     FxTagTrackingBlock* pBlock;
+    BOOLEAN cached;
     LONG pos;
     KIRQL irql;
     USHORT numFrames = 0;
@@ -213,20 +281,35 @@ Return Value:
     if (RefType == TagAddRef) {
 
         //
-        // Try to allocate some memory for the new block.  If unsuccessful,
-        // fallback to a failed count increment.
+        // Reuse a released block and link it in under one acquisition of the
+        // lock.  Only when none is cached do we allocate a new block, and if
+        // that fails, fallback to a failed count increment.
         //
-        pBlock = new(pFxDriverGlobals) FxTagTrackingBlock(Tag, Line, File);
+        m_SpinLock.Acquire(&irql);
+
+        pBlock = PopFreeBlockLocked(Tag, Line, File);
+        if (pBlock != NULL) {
+            pBlock->Next = m_Next;
+            m_Next = pBlock;
+        }
+
+        m_SpinLock.Release(irql);
+
+        if (pBlock == NULL) {
+            pBlock = new(pFxDriverGlobals) FxTagTrackingBlock(Tag, Line, File);
+
+            if (pBlock != NULL) {
+                m_SpinLock.Acquire(&irql);
+                pBlock->Next = m_Next;
+                m_Next = pBlock;
+                m_SpinLock.Release(irql);
+            }
+        }
 
         if (pBlock == NULL) {
             InterlockedIncrement(&m_FailedCount);
         }
         else {
-            m_SpinLock.Acquire(&irql);
-            pBlock->Next = m_Next;
-            m_Next = pBlock;
-            m_SpinLock.Release(irql);
-            
             if (m_CaptureStack && numFrames > 0) {
                 CopyStackFrames(&pBlock->StackFrames, numFrames, frames);
             }
@@ -255,6 +338,11 @@ Return Value:
             pBlock = pBlock->Next;
         }
 
+        //
+        // Cache the unlinked block while we still hold the lock.
+        //
+        cached = (pBlock != NULL && PushFreeBlockLocked(pBlock));
+
         m_SpinLock.Release(irql);
 
         if (pBlock == NULL) {
@@ -281,7 +369,7 @@ Return Value:
                 FxVerifierDbgBreakPoint(pFxDriverGlobals);
             }
         }
-        else {
+        else if (cached == FALSE) {
             delete pBlock;
             pBlock = NULL;
         }
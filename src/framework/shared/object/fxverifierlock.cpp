@@ -49,6 +49,15 @@ FxVerifierOrderMapping FxVerifierCallbackOrderTable[] = {
     FX_VERIFIER_CALLBACKLOCK_ENTRIES()
 };
 
+//
+// Direct-indexed copies of the two tables above, indexed by
+// (ObjectType - FX_TYPES_BASE).  A value of FX_LOCK_ORDER_NONE means the type
+// has no entry.  Built once by FxVerifierLockInitializeOrderMaps.
+//
+USHORT FxVerifierOrderMap[FX_OBJECT_INFO_INDEX_MAP_SIZE];
+
+USHORT FxVerifierCallbackOrderMap[FX_OBJECT_INFO_INDEX_MAP_SIZE];
+
 //
 // Organization of verifier lock structures
 //
@@ -73,8 +82,12 @@ FxVerifierOrderMapping FxVerifierCallbackOrderTable[] = {
 // the hash table entry and chain is also allocated as member fields
 // of the FxVerifierLock class. (m_ThreadTableEntry)
 //
-// The hash table and its chained entries (m_ThreadTableEntry) is protected
-// by a global spinlock, FxDriverGlobals->ThreadTableLock.
+// Each bucket of the hash table and its chained entries (m_ThreadTableEntry)
+// is protected by that bucket's own spinlock.  Since a thread's entry only
+// ever lives in the bucket its address hashes to, acquires on threads which
+// hash to different buckets do not contend with each other.
+// FxDriverGlobals->ThreadTableLock only guards allocating and freeing the
+// table itself.
 //
 // When a lock is acquired, the current threads address is used to look up
 // a FxVerifierThreadTableEntry for it in the hash table.
@@ -129,6 +142,40 @@ FxVerifierLockInitialize(
     return;
 }
 
+//
+// Called once at library init time
+//
+extern "C"
+VOID
+FxVerifierLockInitializeOrderMaps(
+    VOID
+    )
+{
+    pFxVerifierOrderMapping p;
+    ULONG offset;
+
+    RtlZeroMemory(FxVerifierOrderMap, sizeof(FxVerifierOrderMap));
+    RtlZeroMemory(FxVerifierCallbackOrderMap, sizeof(FxVerifierCallbackOrderMap));
+
+    for (p = FxVerifierOrderTable; p->ObjectType != 0; p++) {
+        offset = (ULONG) p->ObjectType - FX_TYPES_BASE;
+        ASSERT(offset < FX_OBJECT_INFO_INDEX_MAP_SIZE);
+
+        if (offset < FX_OBJECT_INFO_INDEX_MAP_SIZE) {
+            FxVerifierOrderMap[offset] = p->ObjectLockOrder;
+        }
+    }
+
+    for (p = FxVerifierCallbackOrderTable; p->ObjectType != 0; p++) {
+        offset = (ULONG) p->ObjectType - FX_TYPES_BASE;
+        ASSERT(offset < FX_OBJECT_INFO_INDEX_MAP_SIZE);
+
+        if (offset < FX_OBJECT_INFO_INDEX_MAP_SIZE) {
+            FxVerifierCallbackOrderMap[offset] = p->ObjectLockOrder;
+        }
+    }
+}
+
 //
 // Called at Driver Frameworks is unloading
 //
@@ -155,6 +202,7 @@ FxVerifierLock::Lock(
 {
     MxThread curThread;
     FxVerifierLock* head;
+    pFxVerifierThreadTableBucket bucket;
     pFxVerifierThreadTableEntry perThreadList;
     KIRQL oldIrql = PASSIVE_LEVEL;
 
@@ -215,25 +263,32 @@ FxVerifierLock::Lock(
         m_OldIrql = *PreviousIrql;
     }
 
-    // Lock the verifier lists
+    bucket = FxVerifierLock::GetThreadTableBucket(FxDriverGlobals, curThread);
+    if (bucket == NULL) {
+        // Verifier is off, or an early memory allocation failure
+        m_OwningThread = curThread;
+        return;
+    }
+
+    // Lock the verifier lists for this thread's bucket
     if (m_UseMutex) {
-        FxDriverGlobals->ThreadTableLock.Acquire(&oldIrql);
+        bucket->Lock.Acquire(&oldIrql);
     }
     else {
-        FxDriverGlobals->ThreadTableLock.AcquireAtDpcLevel();
+        bucket->Lock.AcquireAtDpcLevel();
     }
 
     m_OwningThread = curThread;
 
     // Get our per thread list from the thread table
-    perThreadList = FxVerifierLock::GetThreadTableEntry(curThread, this, FALSE);
+    perThreadList = FxVerifierLock::GetThreadTableEntry(bucket, curThread, this, FALSE);
     if( perThreadList == NULL ) {
 
         if (m_UseMutex) {
-            FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+            bucket->Lock.Release(oldIrql);
         }
         else {
-            FxDriverGlobals->ThreadTableLock.ReleaseFromDpcLevel();
+            bucket->Lock.ReleaseFromDpcLevel();
         }
 
         // Can't get an entry, so return
@@ -288,11 +343,11 @@ FxVerifierLock::Lock(
     //
     if (m_UseMutex) {
         perThreadList->PerThreadPassiveLockList = this;
-        FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+        bucket->Lock.Release(oldIrql);
     }
     else {
         perThreadList->PerThreadDispatchLockList = this;
-        FxDriverGlobals->ThreadTableLock.ReleaseFromDpcLevel();
+        bucket->Lock.ReleaseFromDpcLevel();
     }
 
     return;
@@ -305,6 +360,7 @@ FxVerifierLock::Unlock(
     )
 {
     MxThread curThread;
+    pFxVerifierThreadTableBucket bucket;
     pFxVerifierThreadTableEntry perThreadList;
     KIRQL oldIrql;
 
@@ -322,11 +378,20 @@ FxVerifierLock::Unlock(
         return;
     }
 
-    // Lock the verifier lists
-    FxDriverGlobals->ThreadTableLock.Acquire(&oldIrql);
+    bucket = FxVerifierLock::GetThreadTableBucket(FxDriverGlobals, curThread);
+
+    // Lock the verifier lists for this thread's bucket
+    if (bucket != NULL) {
+        bucket->Lock.Acquire(&oldIrql);
+
+        // Get our per thread list from the thread table
+        perThreadList = FxVerifierLock::GetThreadTableEntry(bucket, m_OwningThread, this, TRUE);
+    }
+    else {
+        oldIrql = PASSIVE_LEVEL;
+        perThreadList = NULL;
+    }
 
-    // Get our per thread list from the thread table
-    perThreadList = FxVerifierLock::GetThreadTableEntry(m_OwningThread, this, TRUE);
     if( perThreadList == NULL ) {
 
         // Can't get our entry, so release the spinlock and return
@@ -336,7 +401,9 @@ FxVerifierLock::Unlock(
 
         m_OwningThread = NULL;
 
-        FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+        if (bucket != NULL) {
+            bucket->Lock.Release(oldIrql);
+        }
 
         if (m_UseMutex) {
             m_Mutex.ReleaseUnsafe();
@@ -372,7 +439,7 @@ FxVerifierLock::Unlock(
 
             m_OwningThread = NULL;
 
-            FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+            bucket->Lock.Release(oldIrql);
 
             m_Mutex.ReleaseUnsafe();
             Mx::MxLeaveCriticalRegion();
@@ -393,7 +460,7 @@ FxVerifierLock::Unlock(
 
             m_OwningThread = NULL;
 
-            FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+            bucket->Lock.Release(oldIrql);
 
             if (AtDpc) {
                 m_Lock.ReleaseFromDpcLevel();
@@ -422,7 +489,7 @@ FxVerifierLock::Unlock(
             perThreadList->PerThreadPassiveLockList = this->m_OwnedLink;
             m_OwnedLink = NULL;
 
-            ReleaseOrReplaceThreadTableEntry(curThread, this);
+            ReleaseOrReplaceThreadTableEntry(bucket, curThread, this);
 
 
 
@@ -471,7 +538,7 @@ FxVerifierLock::Unlock(
                     // the lock, this entry can no longer be referenced if
                     // so.
                     //
-                    ReleaseOrReplaceThreadTableEntry(curThread, this);
+                    ReleaseOrReplaceThreadTableEntry(bucket, curThread, this);
 
 //                    FxVerifierLock::ReplaceThreadTableEntry(curThread, this, perThreadList->PerThreadPassiveLockList);
 
@@ -500,7 +567,7 @@ FxVerifierLock::Unlock(
             perThreadList->PerThreadDispatchLockList = this->m_OwnedLink;
             m_OwnedLink = NULL;
 
-            ReleaseOrReplaceThreadTableEntry(curThread, this);
+            ReleaseOrReplaceThreadTableEntry(bucket, curThread, this);
 
 
 
@@ -549,7 +616,7 @@ FxVerifierLock::Unlock(
                     // the lock, this entry can no longer be referenced if
                     // so.
                     //
-                    ReleaseOrReplaceThreadTableEntry(curThread, this);
+                    ReleaseOrReplaceThreadTableEntry(bucket, curThread, this);
 
 //                    FxVerifierLock::ReplaceThreadTableEntry(curThread, this, perThreadList->PerThreadDispatchLockList);
 
@@ -574,7 +641,7 @@ FxVerifierLock::Unlock(
 
     m_OwningThread = NULL;
 
-    FxDriverGlobals->ThreadTableLock.Release(oldIrql);
+    bucket->Lock.Release(oldIrql);
 
     if (m_UseMutex) {
         m_Mutex.ReleaseUnsafe();
@@ -608,27 +675,26 @@ void
 FxVerifierLock::InitializeLockOrder()
 {
     USHORT ObjectType;
-    pFxVerifierOrderMapping p;
+    USHORT order;
+    ULONG offset;
 
     PFX_DRIVER_GLOBALS FxDriverGlobals = GetDriverGlobals();
 
     ObjectType = m_ParentObject->GetType();
+    offset = (ULONG) ObjectType - FX_TYPES_BASE;
 
-    if( m_CallbackLock ) {
-        p = FxVerifierCallbackOrderTable;
-    }
-    else {
-        p = FxVerifierOrderTable;
-    }
-
-    while( p->ObjectType != 0 ) {
+    if (offset < FX_OBJECT_INFO_INDEX_MAP_SIZE) {
+        if( m_CallbackLock ) {
+            order = FxVerifierCallbackOrderMap[offset];
+        }
+        else {
+            order = FxVerifierOrderMap[offset];
+        }
 
-        if( p->ObjectType == ObjectType ) {
-            m_Order = p->ObjectLockOrder;
+        if (order != FX_LOCK_ORDER_NONE) {
+            m_Order = order;
             return;
         }
-
-        p++;
     }
 
     DoTraceLevelMessage(FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGDEVICE,
@@ -642,24 +708,16 @@ FxVerifierLock::InitializeLockOrder()
 }
 
 //
-// This looks up the supplied thread in the table, and if
-// found returns it.
-//
-// If no entry for the thread is found, create one using the
-// m_ThreadTableEntry for the lock.
+// Returns the thread table bucket the supplied thread hashes to, or NULL
+// if the table was never allocated.
 //
-pFxVerifierThreadTableEntry
-FxVerifierLock::GetThreadTableEntry(
-    __in MxThread        curThread,
-    __in FxVerifierLock* pLock,
-    __in BOOLEAN         LookupOnly
+pFxVerifierThreadTableBucket
+FxVerifierLock::GetThreadTableBucket(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in MxThread           curThread
     )
 {
     ULONG Hash, Index;
-    PLIST_ENTRY head, next;
-    FxVerifierLock* entry;
-
-    PFX_DRIVER_GLOBALS FxDriverGlobals = pLock->GetDriverGlobals();
 
     // Verifier is off, or an early memory allocation failure
     if( FxDriverGlobals->ThreadTable == NULL ) {
@@ -682,7 +740,32 @@ FxVerifierLock::GetThreadTableEntry(
     //
     Index = Hash & (VERIFIER_THREAD_HASHTABLE_SIZE-1);
 
-    head = &FxDriverGlobals->ThreadTable[Index];
+    return &FxDriverGlobals->ThreadTable[Index];
+}
+
+//
+// This looks up the supplied thread in the table, and if
+// found returns it.
+//
+// If no entry for the thread is found, create one using the
+// m_ThreadTableEntry for the lock.
+//
+// Called with Bucket->Lock held.
+//
+pFxVerifierThreadTableEntry
+FxVerifierLock::GetThreadTableEntry(
+    __in pFxVerifierThreadTableBucket Bucket,
+    __in MxThread        curThread,
+    __in FxVerifierLock* pLock,
+    __in BOOLEAN         LookupOnly
+    )
+{
+    PLIST_ENTRY head, next;
+    FxVerifierLock* entry;
+
+    PFX_DRIVER_GLOBALS FxDriverGlobals = pLock->GetDriverGlobals();
+
+    head = &Bucket->Head;
 
     //
     // Walk the list to see if our thread has an entry
@@ -821,6 +904,7 @@ FxVerifierLock::GetThreadTableEntry(
 
 void
 FxVerifierLock::ReleaseOrReplaceThreadTableEntry(
+    __in pFxVerifierThreadTableBucket Bucket,
     __in MxThread        curThread,
     __in FxVerifierLock* pLock
     )
@@ -836,6 +920,8 @@ Routine Description:
 
 Arguments:
 
+    Bucket - Thread table bucket curThread hashes to
+
     curThread - Thread who is holding lock
 
     pLock - Lock whose m_ThreadTableEntry is to be released
@@ -845,8 +931,8 @@ Returns:
 
 Comments:
 
-   This is called with the verifier hash table lock held
-   FxDriverGlobals->ThreadTableLock.
+   This is called with the verifier hash table bucket lock held
+   (Bucket->Lock).
 
    The pLock has already been removed from the held locks chain,
    so the lock at the head of the list can be used for the new hash
@@ -855,7 +941,6 @@ Comments:
 --*/
 
 {
-    ULONG Hash, Index;
     PLIST_ENTRY head;
     FxVerifierLock* pNewLock = NULL;
 
@@ -879,12 +964,7 @@ Comments:
         FxVerifierDbgBreakPoint(FxDriverGlobals);
     }
 
-    Hash = (ULONG)((ULONG_PTR)curThread >> 4);
-    Hash = ((Hash >> 16) & 0x0000FFFF) ^ (Hash & 0x0000FFFF);
-
-    Index = Hash & (VERIFIER_THREAD_HASHTABLE_SIZE-1);
-
-    head = &FxDriverGlobals->ThreadTable[Index];
+    head = &Bucket->Head;
 
     // Remove old entry
     RemoveEntryList(&pLock->m_ThreadTableEntry.HashChain);
@@ -940,7 +1020,7 @@ FxVerifierLock::AllocateThreadTable(
 {
     KIRQL       oldIrql;
     ULONG       newEntries;
-    PLIST_ENTRY newTable;
+    pFxVerifierThreadTableBucket newTable;
 
     FxDriverGlobals->ThreadTableLock.Acquire(&oldIrql);
 
@@ -952,10 +1032,10 @@ FxVerifierLock::AllocateThreadTable(
     // Table must be kept as a power of 2 for hash algorithm
     newEntries = VERIFIER_THREAD_HASHTABLE_SIZE;
 
-    newTable = (PLIST_ENTRY) FxPoolAllocateWithTag(
+    newTable = (pFxVerifierThreadTableBucket) FxPoolAllocateWithTag(
         FxDriverGlobals,
         NonPagedPool,
-        sizeof(LIST_ENTRY) * newEntries,
+        sizeof(FxVerifierThreadTableBucket) * newEntries,
         FxDriverGlobals->Tag);
 
     if( newTable == NULL ) {
@@ -966,7 +1046,8 @@ FxVerifierLock::AllocateThreadTable(
     }
 
     for(ULONG index=0; index < newEntries; index++ ) {
-        InitializeListHead(&newTable[index]);
+        newTable[index].Lock.Initialize();
+        InitializeListHead(&newTable[index].Head);
     }
 
     FxDriverGlobals->ThreadTable     = newTable;
@@ -992,6 +1073,10 @@ FxVerifierLock::FreeThreadTable(
         return;
     }
 
+    for(ULONG index=0; index < VERIFIER_THREAD_HASHTABLE_SIZE; index++ ) {
+        FxDriverGlobals->ThreadTable[index].Lock.Uninitialize();
+    }
+
     FxPoolFree(FxDriverGlobals->ThreadTable);
 
     FxDriverGlobals->ThreadTable = NULL;
@@ -87,6 +87,12 @@ FxVerifierQueryTrackPower(
     __out FxTrackPowerOption* TrackPower
     );
 
+VOID
+FxVerifierQueryTrackHandlesSampleRate(
+    __in HANDLE Key,
+    __out PULONG SampleRate
+    );
+
 //
 // Global allocation tracker
 //
@@ -112,26 +118,60 @@ extern ULONG FxObjectsInfoCount;
 #endif
 
 
-_Must_inspect_result_
+__inline
 BOOLEAN
-FxVerifyObjectTypeInTable(
-    __in USHORT ObjectType
+FxObjectsInfoLookupIndex(
+    __in WDFTYPE ObjectType,
+    __out PULONG Index
     )
+/*++
+
+Routine Description:
+    Maps an object type to its position in FxObjectsInfo in constant time
+    using the index map built by FxObjectsInfoBuildIndexMap.  Since every
+    FxObjectDebugInfo array is allocated parallel to FxObjectsInfo, the same
+    index is valid for those arrays as well.
+
+Arguments:
+    ObjectType - the type to look up
+
+    Index - receives the index into FxObjectsInfo on success
+
+Return Value:
+    TRUE if the type is in the table, FALSE otherwise
+
+--*/
 {
-    ULONG i;
+    ULONG offset;
+    UCHAR entry;
 
-    for (i = 0; i < FxObjectsInfoCount; i++) {
-        if (ObjectType == FxObjectsInfo[i].ObjectType) {
-            return TRUE;
-        }
-        else if (ObjectType > FxObjectsInfo[i].ObjectType) {
-            continue;
-        }
+    offset = (ULONG) ObjectType - FX_TYPES_BASE;
 
+    //
+    // Types below FX_TYPES_BASE wrap around to a large offset.
+    //
+    if (offset >= FX_OBJECT_INFO_INDEX_MAP_SIZE) {
         return FALSE;
     }
 
-    return FALSE;
+    entry = FxLibraryGlobals.ObjectsInfoIndexMap[offset];
+    if (entry == 0) {
+        return FALSE;
+    }
+
+    *Index = entry - 1;
+    return TRUE;
+}
+
+_Must_inspect_result_
+BOOLEAN
+FxVerifyObjectTypeInTable(
+    __in USHORT ObjectType
+    )
+{
+    ULONG index;
+
+    return FxObjectsInfoLookupIndex(ObjectType, &index);
 }
 
 _Must_inspect_result_
@@ -305,6 +345,8 @@ FxDriverGlobalsInitializeDebugExtension(
                                                         FxDriverGlobals
                                                         );
         FxVerifierQueryTrackPower(Key, &pExtension->TrackPower);
+        FxVerifierQueryTrackHandlesSampleRate(
+            Key, &pExtension->TrackHandlesSampleRate);
     }
 
 #if ((FX_CORE_MODE)==(FX_CORE_KERNEL_MODE))
@@ -317,17 +359,10 @@ FxObjectTypeToHandleName(
     __in WDFTYPE ObjectType
     )
 {
-    ULONG i;
+    ULONG index;
 
-    for (i = 0; i < FxObjectsInfoCount; i++) {
-        if (ObjectType == FxObjectsInfo[i].ObjectType) {
-            return FxObjectsInfo[i].HandleName;
-        }
-        else if (ObjectType > FxObjectsInfo[i].ObjectType) {
-            continue;
-        }
-
-        return NULL;
+    if (FxObjectsInfoLookupIndex(ObjectType, &index)) {
+        return FxObjectsInfo[index].HandleName;
     }
 
     return NULL;
@@ -356,21 +391,17 @@ Return Value:
 --*/
 
 {
-    ULONG i;
+    ULONG index;
 
     //
-    // Array size of DebugInfo is the same size as FxObjectsInfo
+    // Array size of DebugInfo is the same size as FxObjectsInfo and is
+    // sorted the same way, so the FxObjectsInfo index applies directly.
     //
-    for (i = 0; i < FxObjectsInfoCount; i++) {
-        if (ObjectType == DebugInfo[i].ObjectType) {
-            return FLAG_TO_BOOL(DebugInfo[i].u.DebugFlags,
-                                FxObjectDebugTrackReferences);
-        }
-        else if (ObjectType > FxObjectsInfo[i].ObjectType) {
-            continue;
-        }
+    if (FxObjectsInfoLookupIndex(ObjectType, &index)) {
+        ASSERT(DebugInfo[index].ObjectType == ObjectType);
 
-        return FALSE;
+        return FLAG_TO_BOOL(DebugInfo[index].u.DebugFlags,
+                            FxObjectDebugTrackReferences);
     }
 
     return FALSE;
@@ -378,22 +409,47 @@ Return Value:
 
 
 VOID
-FxVerifyObjectTableIsSorted(
+FxObjectsInfoBuildIndexMap(
     VOID
     )
+
+/*++
+
+Routine Description:
+    Verifies that FxObjectsInfo is sorted by type (FxObjectDebugInfo arrays
+    and the debugger extension rely on this) and builds the direct-indexed
+    WDFTYPE -> FxObjectsInfo index map used by all type lookups.
+
+--*/
+
 {
-    ULONG i;
+    ULONG i, offset;
     USHORT prevType;
 
-    prevType = FxObjectsInfo[0].ObjectType;
+    ASSERTMSG("FxObjectsInfo table is too large for the index map\n",
+              FxObjectsInfoCount < MAXUCHAR);
+
+    RtlZeroMemory(FxLibraryGlobals.ObjectsInfoIndexMap,
+                  sizeof(FxLibraryGlobals.ObjectsInfoIndexMap));
 
-    for (i = 1; i < FxObjectsInfoCount; i++) {
-        if (prevType >= FxObjectsInfo[i].ObjectType) {
+    prevType = 0;
+
+    for (i = 0; i < FxObjectsInfoCount; i++) {
+        if (i > 0 && prevType >= FxObjectsInfo[i].ObjectType) {
             ASSERTMSG("FxObjectsInfo table is not in sorted order\n",
                          prevType < FxObjectsInfo[i].ObjectType);
         }
 
         prevType = FxObjectsInfo[i].ObjectType;
+
+        offset = (ULONG) FxObjectsInfo[i].ObjectType - FX_TYPES_BASE;
+        if (offset >= FX_OBJECT_INFO_INDEX_MAP_SIZE || i >= MAXUCHAR) {
+            ASSERTMSG("FxObjectsInfo type is outside of the index map\n",
+                      FALSE);
+            continue;
+        }
+
+        FxLibraryGlobals.ObjectsInfoIndexMap[offset] = (UCHAR) (i + 1);
     }
 }
 
@@ -662,9 +718,15 @@ FxLibraryGlobalsCommission(
                   sizeof(FxLibraryGlobals.MachineSleepStates));
 
     //
-    // Insure that the FxObject is layed-up correctly.
+    // Insure that the FxObject is layed-up correctly and build the type
+    // lookup map.
     //
-    FxVerifyObjectTableIsSorted();
+    FxObjectsInfoBuildIndexMap();
+
+    //
+    // Precompute the WDFTYPE -> lock order mappings used by FxVerifierLock.
+    //
+    FxVerifierLockInitializeOrderMaps();
 
     //
     // Initialize the list of FxDriverGlobals.
@@ -1159,6 +1221,32 @@ FxAllocateDriverGlobals(
     //
     pFxDriverGlobals->FxDsfOn  = FALSE;
 
+    //
+    // Small common buffers get dedicated allocations unless the driver opts
+    // in to the common buffer pool.
+    //
+    pFxDriverGlobals->FxCommonBufferPoolOn = FALSE;
+
+    //
+    // I/O target completions are delivered inline unless the driver opts in
+    // to queued completion.
+    //
+    pFxDriverGlobals->FxIoTargetCompletionQueueOn = FALSE;
+
+    //
+    // Writes sent to a USB pipe go out one transfer per request unless the
+    // driver opts in to write coalescing.
+    //
+    pFxDriverGlobals->FxUsbWriteCoalescingOn = FALSE;
+    pFxDriverGlobals->FxUsbWriteCoalescingTransfers = 0;
+    pFxDriverGlobals->FxIoTargetDirectBufferedIoOn = FALSE;
+
+    //
+    // UMDF interrupts park on their event after each interrupt unless the
+    // driver opts in to spin delivery.
+    //
+    pFxDriverGlobals->FxInterruptSpinDeliveryMaxUs = 0;
+
     //
     // Allocate a telemetry context if a telemetry client is enabled, for any level/keyword.
     //
@@ -1325,6 +1413,28 @@ FxVerifierQueryTrackPower(
     }
 }
 
+VOID
+FxVerifierQueryTrackHandlesSampleRate(
+    __in HANDLE Key,
+    __out PULONG SampleRate
+    )
+{
+    NTSTATUS status;
+    ULONG value = 0;
+    DECLARE_CONST_UNICODE_STRING(valueName, L"TrackHandlesSampleRate");
+
+    //
+    // 0 and 1 both mean every object of a tracked type is tracked.
+    //
+    status = FxRegKey::_QueryULong(Key, &valueName, &value);
+    if (NT_SUCCESS(status) && value > 1) {
+        *SampleRate = value;
+    }
+    else {
+        *SampleRate = 1;
+    }
+}
+
 VOID
 FxOverrideDefaultVerifierSettings(
     __in    HANDLE Key,
@@ -1689,6 +1799,50 @@ Arguments:
         FxDriverGlobals->FxDsfOn = (dsfValue) ? TRUE : FALSE;
 
         FxDriverGlobals->RemoveLockOptionFlags = removeLockOptionFlags;
+
+#if (FX_CORE_MODE==FX_CORE_KERNEL_MODE)
+        FxOverrideDefaultVerifierSettings(hWdf.m_Key,
+                                          L"CommonBufferPoolOn",
+                                          &FxDriverGlobals->FxCommonBufferPoolOn);
+
+        FxOverrideDefaultVerifierSettings(hWdf.m_Key,
+                                          L"IoTargetCompletionQueueOn",
+                                          &FxDriverGlobals->FxIoTargetCompletionQueueOn);
+
+        FxOverrideDefaultVerifierSettings(hWdf.m_Key,
+                                          L"UsbWriteCoalescingOn",
+                                          &FxDriverGlobals->FxUsbWriteCoalescingOn);
+
+        ULONG transfersValue = 0;
+        DECLARE_CONST_UNICODE_STRING(transfersName, L"UsbWriteCoalescingTransfers");
+
+        //
+        // Get the number of merged transfers kept in flight if present.
+        //
+        if (NT_SUCCESS(FxRegKey::_QueryULong(hWdf.m_Key,
+                                             &transfersName,
+                                             &transfersValue))) {
+
+            FxDriverGlobals->FxUsbWriteCoalescingTransfers = transfersValue;
+        }
+
+        FxOverrideDefaultVerifierSettings(hWdf.m_Key,
+                                          L"IoTargetDirectBufferedIoOn",
+                                          &FxDriverGlobals->FxIoTargetDirectBufferedIoOn);
+#else
+        ULONG spinValue = 0;
+        DECLARE_CONST_UNICODE_STRING(spinName, L"InterruptSpinDeliveryMaxUs");
+
+        //
+        // Get the interrupt spin delivery bound if present.
+        //
+        if (NT_SUCCESS(FxRegKey::_QueryULong(hWdf.m_Key,
+                                             &spinName,
+                                             &spinValue))) {
+
+            FxDriverGlobals->FxInterruptSpinDeliveryMaxUs = spinValue;
+        }
+#endif
     }
 
     return;
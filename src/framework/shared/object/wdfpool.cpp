@@ -72,6 +72,251 @@ Returns:
 }
 
 
+//
+// Block sizes (including FX_POOL_HEADER_SIZE) of the small allocation cache
+// size classes.  Chosen to cover the common sizeof(Fx*) values of non-request
+// framework objects plus their headers.
+//
+static const USHORT FxPoolCacheClassSizes[FX_POOL_CACHE_CLASSES] = {
+    64, 128, 192, 256, 384, FX_POOL_CACHE_MAX_SIZE
+};
+
+__inline
+ULONG
+FxPoolCacheGetClass(
+    __in SIZE_T BlockSize
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < FX_POOL_CACHE_CLASSES; i++) {
+        if (BlockSize <= FxPoolCacheClassSizes[i]) {
+            return i;
+        }
+    }
+
+    return FX_POOL_CACHE_CLASSES;
+}
+
+__inline
+ULONG
+FxPoolCacheGetType(
+    __in POOL_TYPE Type
+    )
+/*++
+
+Routine Description:
+
+    Maps a pool type to the index of its cache, FX_POOL_CACHE_TYPES if the
+    pool type is not cached.
+
+--*/
+{
+    switch (Type) {
+    case NonPagedPool:
+        return 0;
+
+    case NonPagedPoolNx:
+        return FX_POOL_CACHE_TYPE_NX;
+
+    default:
+        return FX_POOL_CACHE_TYPES;
+    }
+}
+
+__inline
+FX_POOL_CACHE_LIST*
+FxPoolCacheGetList(
+    __in PFX_POOL_CACHE Cache,
+    __in ULONG CacheType,
+    __in ULONG Class
+    )
+{
+    ULONG shard;
+
+    shard = Mx::MxGetCurrentProcessorNumber() & (FX_POOL_CACHE_SHARDS - 1);
+
+    return &Cache->Shards[shard].Classes[CacheType][Class];
+}
+
+PVOID
+FxPoolCacheAllocate(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in PFX_POOL  Pool,
+    __in POOL_TYPE Type,
+    __in ULONG     CacheType,
+    __in ULONG     Class
+    )
+/*++
+
+Routine Description:
+
+    Allocates a block of the given pool type and size class from the small
+    allocation cache, falling back to the system allocator when the current
+    processor's free list is empty.
+
+Returns:
+
+    Pointer to the caller usable part of the block, or NULL
+
+--*/
+{
+    FX_POOL_CACHE_LIST* pList;
+    PFX_POOL_HEADER pHeader;
+    PVOID pBlock;
+
+    pList = FxPoolCacheGetList(&Pool->Cache, CacheType, Class);
+
+    pBlock = InterlockedPopEntrySList(&pList->ListHead);
+    if (pBlock != NULL) {
+        InterlockedDecrement(&pList->Depth);
+        InterlockedIncrement(&pList->Hits);
+    }
+    else {
+        InterlockedIncrement(&pList->Misses);
+
+        pBlock = MxMemory::MxAllocatePoolWithTag(Type,
+                                                 FxPoolCacheClassSizes[Class],
+                                                 FxDriverGlobals->Tag);
+        if (pBlock == NULL) {
+            return NULL;
+        }
+    }
+
+    pHeader = (PFX_POOL_HEADER) pBlock;
+    pHeader->Base = (PVOID) (((ULONG_PTR) Class << FX_POOL_HEADER_CLASS_SHIFT) |
+                             ((ULONG_PTR) CacheType << FX_POOL_HEADER_TYPE_SHIFT) |
+                             FX_POOL_HEADER_CACHED);
+    pHeader->FxDriverGlobals = FxDriverGlobals;
+
+    return &pHeader->AllocationStart[0];
+}
+
+VOID
+FxPoolCacheFree(
+    __in PFX_POOL_HEADER Header
+    )
+/*++
+
+Routine Description:
+
+    Returns a block allocated by FxPoolCacheAllocate to the current
+    processor's free list for its pool type and size class, or to the system
+    if that list is already full or the cache has been torn down.
+
+--*/
+{
+    FX_POOL_CACHE_LIST* pList;
+    PFX_POOL_CACHE pCache;
+    ULONG_PTR base;
+    ULONG cacheType, cls;
+
+    base = (ULONG_PTR) Header->Base;
+    cacheType = (ULONG) ((base >> FX_POOL_HEADER_TYPE_SHIFT) & FX_POOL_HEADER_TYPE_MASK);
+    cls = (ULONG) ((base >> FX_POOL_HEADER_CLASS_SHIFT) & FX_POOL_HEADER_CLASS_MASK);
+
+    ASSERT(cacheType < FX_POOL_CACHE_TYPES);
+    ASSERT(cls < FX_POOL_CACHE_CLASSES);
+
+    pCache = &Header->FxDriverGlobals->FxPoolFrameworks.Cache;
+
+    if (pCache->Enabled == FALSE) {
+        MxMemory::MxFreePool(Header);
+        return;
+    }
+
+    pList = FxPoolCacheGetList(pCache, cacheType, cls);
+
+    if (pList->Depth >= FX_POOL_CACHE_MAX_DEPTH) {
+        InterlockedIncrement(&pList->FreeMisses);
+        MxMemory::MxFreePool(Header);
+        return;
+    }
+
+    InterlockedIncrement(&pList->Depth);
+    InterlockedPushEntrySList(&pList->ListHead, (PSLIST_ENTRY) Header);
+}
+
+VOID
+FxPoolCacheInitialize(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in PFX_POOL_CACHE Cache
+    )
+{
+    FX_POOL_CACHE_LIST* pList;
+    ULONG i, j, k;
+
+    for (i = 0; i < FX_POOL_CACHE_SHARDS; i++) {
+        for (j = 0; j < FX_POOL_CACHE_TYPES; j++) {
+            for (k = 0; k < FX_POOL_CACHE_CLASSES; k++) {
+                pList = &Cache->Shards[i].Classes[j][k];
+
+                InitializeSListHead(&pList->ListHead);
+                pList->Depth = 0;
+                pList->Hits = 0;
+                pList->Misses = 0;
+                pList->FreeMisses = 0;
+            }
+        }
+    }
+
+    Cache->Enabled = FxDriverGlobals->IsPoolTrackingOn() ? FALSE : TRUE;
+}
+
+VOID
+FxPoolCacheDestroy(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in PFX_POOL_CACHE Cache
+    )
+/*++
+
+Routine Description:
+
+    Logs the cache statistics and releases every cached block back to the
+    system.  Called at unload after the last free.  Blocks freed after this
+    point go straight back to the system.
+
+--*/
+{
+    FX_POOL_CACHE_LIST* pList;
+    PSLIST_ENTRY pEntry;
+    LONG hits, misses, freeMisses;
+    ULONG i, j, k;
+
+    Cache->Enabled = FALSE;
+
+    for (j = 0; j < FX_POOL_CACHE_TYPES; j++) {
+        for (k = 0; k < FX_POOL_CACHE_CLASSES; k++) {
+            hits = 0;
+            misses = 0;
+            freeMisses = 0;
+
+            for (i = 0; i < FX_POOL_CACHE_SHARDS; i++) {
+                pList = &Cache->Shards[i].Classes[j][k];
+
+                hits += pList->Hits;
+                misses += pList->Misses;
+                freeMisses += pList->FreeMisses;
+
+                while ((pEntry = InterlockedPopEntrySList(&pList->ListHead)) != NULL) {
+                    MxMemory::MxFreePool(pEntry);
+                }
+
+                pList->Depth = 0;
+            }
+
+            if (hits != 0 || misses != 0) {
+                DoTraceLevelMessage(
+                    FxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPOOL,
+                    "Pool cache %s class %d bytes: Hits %d, Misses %d, "
+                    "FreeMisses %d",
+                    j == FX_POOL_CACHE_TYPE_NX ? "NonPagedPoolNx" : "NonPagedPool",
+                    FxPoolCacheClassSizes[k], hits, misses, freeMisses);
+            }
+        }
+    }
+}
+
 PVOID
 FxPoolAllocator(
     __in PFX_DRIVER_GLOBALS FxDriverGlobals,
@@ -290,6 +535,27 @@ Remarks:
         // No pool tracking...
         //
 
+        //
+        // Small non-paged allocations are served from the per processor
+        // size class cache.  FxPoolFree finds the cache through the
+        // header's FxDriverGlobals, so only the driver's own pool is cached.
+        // A cached block may be handed to any later caller, so allocations
+        // with a caller specified tag bypass the cache to keep their tag.
+        // Size is small enough here that adding the header can not overflow.
+        //
+        if (Pool->Cache.Enabled &&
+            Pool == &FxDriverGlobals->FxPoolFrameworks &&
+            Tag == FxDriverGlobals->Tag &&
+            FxPoolCacheGetType(Type) < FX_POOL_CACHE_TYPES &&
+            Size <= FX_POOL_CACHE_MAX_SIZE - FX_POOL_HEADER_SIZE) {
+            return FxPoolCacheAllocate(
+                FxDriverGlobals,
+                Pool,
+                Type,
+                FxPoolCacheGetType(Type),
+                FxPoolCacheGetClass(Size + FX_POOL_HEADER_SIZE));
+        }
+
         if ((Size < PAGE_SIZE) || Mx::IsUM())
         {
             //
@@ -422,6 +688,15 @@ Remarks:
     // Dereference the Common header which all <PAGE_SIZE allcations will have.
     //
     pHeader = CONTAINING_RECORD(ptr, FX_POOL_HEADER, AllocationStart);
+
+    //
+    // Blocks from the small allocation cache go back to the cache
+    //
+    if ((ULONG_PTR) pHeader->Base & FX_POOL_HEADER_CACHED) {
+        FxPoolCacheFree(pHeader);
+        return;
+    }
+
     pTrueBase = pHeader->Base;
 
     //
@@ -477,9 +752,12 @@ Returns:
 --*/
 {
     PFX_POOL_TRACKER pTracker;
+    PFX_POOL_TRACKER_SHARD pShard;
+    PFX_POOL_TAG_STATS pStats;
     PLIST_ENTRY ple;
     KIRQL oldIrql;
     BOOLEAN leak;
+    ULONG i;
 
     //
     // Dump usage information
@@ -497,6 +775,17 @@ Returns:
         Pool->PeakNonPagedAllocations, Pool->PeakPagedAllocations
         );
 
+    for (i = 0; i < FX_POOL_TAG_STATS_ENTRIES; i++) {
+        pStats = &Pool->TagStats[i];
+
+        if (pStats->Tag != 0 && pStats->Allocations != 0) {
+            DoTraceLevelMessage(
+                FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGDEVICE,
+                "FxPoolDump: Tag 0x%x Allocations %d Bytes %I64d",
+                pStats->Tag, pStats->Allocations, (ULONGLONG) pStats->Bytes);
+        }
+    }
+
     leak = FALSE;
 
     //
@@ -519,26 +808,29 @@ Returns:
     Pool->PagedLock.Release();
 
     //
-    // Check non-paged pool for leaks
+    // Check non-paged pool for leaks, merging the per processor shards
     //
+    for (i = 0; i < FX_POOL_TRACKER_SHARDS; i++) {
+        pShard = &Pool->NonPagedShards[i];
 
-    Pool->NonPagedLock.Acquire(&oldIrql);
+        pShard->Lock.Acquire(&oldIrql);
 
-    for (ple = Pool->NonPagedHead.Flink;
-         ple != &Pool->NonPagedHead;
-         ple = ple->Flink) {
-        pTracker = CONTAINING_RECORD(ple, FX_POOL_TRACKER, Link );
+        for (ple = pShard->Head.Flink;
+             ple != &pShard->Head;
+             ple = ple->Flink) {
+            pTracker = CONTAINING_RECORD(ple, FX_POOL_TRACKER, Link );
 
-        // Leaker
-        leak = TRUE;
+            // Leaker
+            leak = TRUE;
 
-        DoTraceLevelMessage(
-            FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGDEVICE,
-            "FX_POOL 0x%p leaked non-paged memory alloc 0x%p (tracking block %p)",
-            Pool, pTracker+1, pTracker);
-    }
+            DoTraceLevelMessage(
+                FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGDEVICE,
+                "FX_POOL 0x%p leaked non-paged memory alloc 0x%p (tracking block %p)",
+                Pool, pTracker+1, pTracker);
+        }
 
-    Pool->NonPagedLock.Release(oldIrql);
+        pShard->Lock.Release(oldIrql);
+    }
 
     if (leak) {
         FxVerifierDbgBreakPoint(FxDriverGlobals);
@@ -569,14 +861,18 @@ Returns:
 --*/
 {
     NTSTATUS status = STATUS_SUCCESS;
+    ULONG i;
 
     DoTraceLevelMessage(FxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPOOL,
                         "Initializing Pool 0x%p, Tracking %d",
                         Pool, FxDriverGlobals->IsPoolTrackingOn());
 
-    Pool->NonPagedLock.Initialize();
+    for (i = 0; i < FX_POOL_TRACKER_SHARDS; i++) {
+        Pool->NonPagedShards[i].Lock.Initialize();
+        InitializeListHead(&Pool->NonPagedShards[i].Head);
+    }
 
-    InitializeListHead( &Pool->NonPagedHead );
+    FxPoolCacheInitialize(FxDriverGlobals, &Pool->Cache);
 
     status = Pool->PagedLock.Initialize();
     if (!NT_SUCCESS(status)) {
@@ -602,6 +898,8 @@ Returns:
     Pool->PeakNonPagedAllocations = 0;
     Pool->PeakPagedAllocations = 0;
 
+    RtlZeroMemory(Pool->TagStats, sizeof(Pool->TagStats));
+
 exit:
     if (!NT_SUCCESS(status)) {
         //
@@ -641,6 +939,8 @@ Returns:
 
 --*/
 {
+    ULONG i;
+
     DoTraceLevelMessage(FxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGPOOL,
                         "Destroying Pool 0x%p", Pool);
 
@@ -656,8 +956,13 @@ Returns:
         //
     }
 
+    FxPoolCacheDestroy(FxDriverGlobals, &Pool->Cache);
+
     Pool->PagedLock.Uninitialize();
-    Pool->NonPagedLock.Uninitialize();
+
+    for (i = 0; i < FX_POOL_TRACKER_SHARDS; i++) {
+        Pool->NonPagedShards[i].Lock.Uninitialize();
+    }
 
     return;
 }
@@ -216,6 +216,35 @@ FxRequestBuffer::GetBufferLength(
     }
 }
 
+BOOLEAN
+FxRequestBuffer::IsNonPagedWritableMemory(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Determines if the buffer is a framework allocated, non paged and writable
+    memory object.  Such memory is referenced by the request context while the
+    I/O is outstanding, so it can be handed to a target directly instead of
+    being double buffered.
+
+Arguments:
+    None
+
+Return Value:
+    TRUE if the buffer can be used directly as a system buffer
+
+  --*/
+{
+    if (DataType != FxRequestBufferMemory) {
+        return FALSE;
+    }
+
+    return ((u.Memory.Memory->GetFlags() &
+             (IFxMemoryFlagNonPaged | IFxMemoryFlagReadOnly)) ==
+                IFxMemoryFlagNonPaged) ? TRUE : FALSE;
+}
+
 _Must_inspect_result_
 NTSTATUS
 FxRequestBuffer::GetBuffer(
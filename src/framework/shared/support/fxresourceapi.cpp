@@ -318,7 +318,7 @@ Return Value:
                          (PVOID*) &pIoResReqList);
 
     pIoResReqList->Lock(&irql);
-    pObject = pIoResReqList->GetItem(Index);
+    pObject = pIoResReqList->GetItemIndexedLocked(Index);
     pIoResReqList->Unlock(irql);
 
     if (pObject == NULL) {
@@ -438,6 +438,7 @@ Return Value:
             pList->MarkChanged();
 
             pList->RemoveEntry(cur);
+            pList->InvalidateIndex();
             listFound = TRUE;
             break;
         }
@@ -712,7 +713,7 @@ Return Value:
     FxPointerNotNull(pFxDriverGlobals, Descriptor);
 
     pList->Lock(&irql);
-    pObject = (FxResourceIo*) pList->GetItem(Index);
+    pObject = (FxResourceIo*) pList->GetItemIndexedLocked(Index);
     pList->Unlock(irql);
 
     if (pObject != NULL) {
@@ -818,7 +819,7 @@ Return Value:
                          (PVOID*) &pList);
 
     pList->Lock(&irql);
-    pObject = (FxResourceIo*) pList->GetItem(Index);
+    pObject = (FxResourceIo*) pList->GetItemIndexedLocked(Index);
     pList->Unlock(irql);
 
     if (pObject == NULL) {
@@ -960,6 +961,7 @@ Return Value:
             pList->m_OwningList->MarkChanged();
 
             pList->RemoveEntry(cur);
+            pList->InvalidateIndex();
             break;
         }
 
@@ -1291,6 +1293,7 @@ Return Value:
             pList->MarkChanged();
 
             pList->RemoveEntry(cur);
+            pList->InvalidateIndex();
             break;
         }
 
@@ -31,6 +31,81 @@ extern "C" {
 #endif
 }
 
+FxResourceCollection::~FxResourceCollection(
+    VOID
+    )
+{
+    if (m_IndexTable != NULL) {
+        FxPoolFree(m_IndexTable);
+        m_IndexTable = NULL;
+    }
+}
+
+_Must_inspect_result_
+FxObject*
+FxResourceCollection::GetItemIndexedLocked(
+    __in ULONG Index
+    )
+/*++
+
+Routine Description:
+    Returns the object at the given index without walking the collection.  If
+    the collection changed shape since the last lookup, the index table is
+    rebuilt first.  The caller must hold the collection's lock.
+
+Arguments:
+    Index - zero based index into the collection
+
+Return Value:
+    the object at Index, NULL if Index is out of range
+
+  --*/
+{
+    FxCollectionEntry *cur, *end;
+    FxObject** pTable;
+    ULONG size, i;
+
+    if (m_IndexValid == FALSE) {
+        if (m_IndexTableSize < m_Count) {
+            if (!NT_SUCCESS(RtlULongMult(m_Count, sizeof(FxObject*), &size))) {
+                return GetItem(Index);
+            }
+
+            pTable = (FxObject**) FxPoolAllocate(GetDriverGlobals(),
+                                                 NonPagedPool,
+                                                 size);
+            if (pTable == NULL) {
+                //
+                // Not fatal, the lookup just falls back to the list walk and
+                // the table is retried on the next lookup.
+                //
+                return GetItem(Index);
+            }
+
+            if (m_IndexTable != NULL) {
+                FxPoolFree(m_IndexTable);
+            }
+
+            m_IndexTable = pTable;
+            m_IndexTableSize = m_Count;
+        }
+
+        for (cur = Start(), end = End(), i = 0;
+             cur != end;
+             cur = cur->Next(), i++) {
+            m_IndexTable[i] = cur->m_Object;
+        }
+
+        m_IndexValid = TRUE;
+    }
+
+    if (Index >= m_Count) {
+        return NULL;
+    }
+
+    return m_IndexTable[Index];
+}
+
 BOOLEAN
 FxResourceCollection::RemoveAndDelete(
     __in ULONG Index
@@ -81,6 +156,7 @@ Return Value:
         // Remove the entry
         //
         RemoveEntry(pEntry);
+        InvalidateIndex();
     }
     Unlock(irql);
 
@@ -190,6 +266,7 @@ Return Value:
         ple->Blink = &pNew->m_ListEntry;
 
         AddEntry(pNew, Object);
+        InvalidateIndex();
 
         //
         // Mark the list as changed so when we go to create a WDM resource list
@@ -273,8 +350,11 @@ Return Value:
         pWdmDescriptor++;
     }
 
+    InvalidateIndex();
+
     if (NT_SUCCESS(status)) {
         status = m_OwningList->Add(this) ? STATUS_SUCCESS : STATUS_INSUFFICIENT_RESOURCES;
+        m_OwningList->InvalidateIndex();
     }
 
     if (NT_SUCCESS(status)) {
@@ -314,6 +394,7 @@ Return Value:
     status = STATUS_SUCCESS;
 
     Clear();
+    InvalidateIndex();
 
     m_AccessFlags = AccessFlags;
 
@@ -454,7 +535,7 @@ FxCmResList::GetDescriptor(
     KIRQL irql;
 
     Lock(&irql);
-    pObject = (FxResourceCm*) GetItem(Index);
+    pObject = (FxResourceCm*) GetItemIndexedLocked(Index);
     Unlock(irql);
 
     if (pObject == NULL) {
@@ -472,6 +553,63 @@ FxCmResList::GetDescriptor(
     }
 }
 
+PCM_PARTIAL_RESOURCE_DESCRIPTOR
+FxCmResList::GetNextDescriptorOfType(
+    __in UCHAR Type,
+    __inout PULONG Cursor
+    )
+/*++
+
+Routine Description:
+    Returns the next descriptor of the given type at or after *Cursor and
+    moves *Cursor past it.  Starting with *Cursor at zero and calling until
+    NULL is returned visits every descriptor of that type in a single pass
+    over the list.
+
+Arguments:
+    Type - CmResourceTypeXxx value to match
+
+    Cursor - zero based index at which to resume the search
+
+Return Value:
+    the clone of the matching descriptor, NULL if there are no more
+
+  --*/
+{
+    FxResourceCm* pObject;
+    ULONG i;
+    KIRQL irql;
+
+    pObject = NULL;
+
+    Lock(&irql);
+
+    for (i = *Cursor; i < Count(); i++) {
+        pObject = (FxResourceCm*) GetItemIndexedLocked(i);
+
+        if (pObject != NULL && pObject->m_Descriptor.Type == Type) {
+            break;
+        }
+
+        pObject = NULL;
+    }
+
+    Unlock(irql);
+
+    if (pObject == NULL) {
+        *Cursor = i;
+        return NULL;
+    }
+
+    *Cursor = i + 1;
+
+    RtlCopyMemory(&pObject->m_DescriptorClone,
+                  &pObject->m_Descriptor,
+                  sizeof(pObject->m_Descriptor));
+
+    return &pObject->m_DescriptorClone;
+}
+
 _Must_inspect_result_
 FxIoResReqList*
 FxIoResReqList::_CreateFromWdmList(
@@ -759,30 +759,14 @@ FxCmResList::CheckForConnectionResources(
     VOID
     )
 {
-    NTSTATUS status;    
-    ULONG i;
-    ULONG count;
-    PCM_PARTIAL_RESOURCE_DESCRIPTOR pDescriptor;
+    ULONG cursor;
 
-    status = STATUS_SUCCESS;
-    count = GetCount();
+    cursor = 0;
 
-    for (i = 0; i < count; i++) {
-        pDescriptor = GetDescriptor(i);
-        if (pDescriptor == NULL) {
-            status = STATUS_INVALID_DEVICE_STATE;
-            DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGPNP,
-                        "Resource Descriptor not found %!STATUS!", status);           
-            goto exit;
-        }
-
-        if (pDescriptor->Type == CmResourceTypeConnection) {
-            m_HasConnectionResources = TRUE;
-            break;
-        }
+    if (GetNextDescriptorOfType(CmResourceTypeConnection, &cursor) != NULL) {
+        m_HasConnectionResources = TRUE;
     }
 
-exit:
-    return status;
+    return STATUS_SUCCESS;
 }
 
@@ -75,6 +75,11 @@ FxIoTarget::Construct(
     m_TargetIoType = WdfDeviceIoUndefined;
     m_IoCount = 1;
     m_DisposeEvent = NULL;
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    m_BounceBufferCache = NULL;
+#endif
+    m_CompletionRing = NULL;
+    m_SyncShellPool = NULL;
     m_TransactionedEntry.SetTransactionedObject(this);
 
     m_PendedQueue.Initialize(this, _RequestCancelled);
@@ -93,6 +98,47 @@ FxIoTarget::~FxIoTarget()
     ASSERT(IsListEmpty(&m_SentIoListHead));
     ASSERT(IsListEmpty(&m_IgnoredIoListHead));
     ASSERT(m_IoCount == 0);
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    if (m_BounceBufferCache != NULL) {
+        //
+        // Buffers still owned by request contexts keep the cache alive, they
+        // are freed as they are returned.
+        //
+        m_BounceBufferCache->Closed = TRUE;
+        _ReleaseBounceBufferCache(m_BounceBufferCache);
+        m_BounceBufferCache = NULL;
+    }
+#endif
+
+    if (m_CompletionRing != NULL) {
+        ASSERT(m_CompletionRing->Head == m_CompletionRing->Tail);
+        FxPoolFree(m_CompletionRing);
+        m_CompletionRing = NULL;
+    }
+
+    if (m_SyncShellPool != NULL) {
+        PSLIST_ENTRY pEntry;
+        FxSyncRequestShell* pShell;
+        ULONG i;
+
+        for (i = 0; i < FX_SYNC_REQUEST_SHELL_SHARDS; i++) {
+            while ((pEntry = InterlockedPopEntrySList(
+                        &m_SyncShellPool->Shards[i].ListHead)) != NULL) {
+                pShell = CONTAINING_RECORD(pEntry, FxSyncRequestShell, ListEntry);
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+                if (pShell->Irp != NULL) {
+                    FxIrp irp(pShell->Irp);
+                    irp.FreeIrp();
+                }
+#endif
+                delete pShell;
+            }
+        }
+
+        FxPoolFree(m_SyncShellPool);
+        m_SyncShellPool = NULL;
+    }
 }
 
 VOID
@@ -145,6 +191,13 @@ FxIoTarget::WaitForDisposeEvent(
         event->EnterCRAndWaitAndLeave();
     }
 
+    //
+    // Queued completions hold m_IoCount references, so they have all been
+    // delivered by now.  The drain which delivered the last one may still be
+    // on its way out.
+    //
+    FlushCompletionQueue();
+
     m_DisposeEvent = NULL;
     ASSERT(m_IoCount == 0);
 }
@@ -1651,15 +1704,457 @@ FxIoTarget::Submit(
     return result;
 }
 
+FxSyncRequestShell*
+FxIoTarget::AcquireSyncShell(
+    __in BOOLEAN NeedIrp
+    )
+/*++
+
+Routine Description:
+    Takes a sync request shell from the current processor's shard of the
+    pool, creating the pool or the shell if needed.  When NeedIrp is set the
+    shell's irp is (re)allocated if it is missing or has fewer stack
+    locations than the target currently needs.
+
+Arguments:
+    NeedIrp - TRUE if the caller will send the shell's irp
+
+Return Value:
+    The shell or NULL on failure, in which case the caller creates its own
+    resources.  A returned shell may have a NULL Irp.
+
+  --*/
+{
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    FxSyncRequestShellPool* pPool;
+    FxSyncRequestShellShard* pShard;
+    FxSyncRequestShell* pShell;
+    PSLIST_ENTRY pEntry;
+    NTSTATUS status;
+    ULONG i;
+
+    pFxDriverGlobals = GetDriverGlobals();
+
+    pPool = m_SyncShellPool;
+
+    if (pPool == NULL) {
+        pPool = (FxSyncRequestShellPool*) FxPoolAllocate(pFxDriverGlobals,
+                                                         NonPagedPool,
+                                                         sizeof(*pPool));
+        if (pPool == NULL) {
+            return NULL;
+        }
+
+        for (i = 0; i < FX_SYNC_REQUEST_SHELL_SHARDS; i++) {
+            InitializeSListHead(&pPool->Shards[i].ListHead);
+            pPool->Shards[i].Depth = 0;
+        }
+
+        if (InterlockedCompareExchangePointer((PVOID*) &m_SyncShellPool,
+                                              pPool,
+                                              NULL) != NULL) {
+            FxPoolFree(pPool);
+            pPool = m_SyncShellPool;
+        }
+    }
+
+    pShard = &pPool->Shards[Mx::MxGetCurrentProcessorNumber() &
+                            (FX_SYNC_REQUEST_SHELL_SHARDS - 1)];
+
+    pEntry = InterlockedPopEntrySList(&pShard->ListHead);
+    if (pEntry != NULL) {
+        InterlockedDecrement(&pShard->Depth);
+        pShell = CONTAINING_RECORD(pEntry, FxSyncRequestShell, ListEntry);
+    }
+    else {
+        pShell = new(pFxDriverGlobals) FxSyncRequestShell();
+        if (pShell == NULL) {
+            return NULL;
+        }
+
+        status = pShell->Event.Initialize();
+        if (!NT_SUCCESS(status)) {
+            delete pShell;
+            return NULL;
+        }
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+        pShell->Irp = NULL;
+        pShell->StackSize = 0;
+#endif
+    }
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    if (NeedIrp && pShell->StackSize < m_TargetStackSize) {
+        if (pShell->Irp != NULL) {
+            FxIrp irp(pShell->Irp);
+            irp.FreeIrp();
+        }
+
+        pShell->Irp = FxIrp::AllocateIrp(m_TargetStackSize, GetDevice());
+        pShell->StackSize = (pShell->Irp != NULL) ? m_TargetStackSize : 0;
+    }
+#else
+    UNREFERENCED_PARAMETER(NeedIrp);
+#endif
+
+    return pShell;
+}
+
+VOID
+FxIoTarget::ReleaseSyncShell(
+    __in FxSyncRequestShell* Shell
+    )
+/*++
+
+Routine Description:
+    Returns a shell taken by AcquireSyncShell.  The event is cleared and the
+    irp reinitialized so the next user sees them fresh.
+
+Arguments:
+    Shell - shell to return
+
+Return Value:
+    None
+
+  --*/
+{
+    FxSyncRequestShellShard* pShard;
+
+    //
+    // A FxSyncRequest sets its destroyed event when its last reference goes
+    // away even if nobody waits for it.
+    //
+    Shell->Event.Clear();
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    if (Shell->Irp != NULL) {
+        FxIrp irp(Shell->Irp);
+        irp.Reuse(STATUS_SUCCESS);
+    }
+#endif
+
+    pShard = &m_SyncShellPool->Shards[Mx::MxGetCurrentProcessorNumber() &
+                                      (FX_SYNC_REQUEST_SHELL_SHARDS - 1)];
+
+    if (pShard->Depth >= FX_SYNC_REQUEST_SHELL_MAX_DEPTH) {
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+        if (Shell->Irp != NULL) {
+            FxIrp irp(Shell->Irp);
+            irp.FreeIrp();
+        }
+#endif
+        delete Shell;
+    }
+    else {
+        InterlockedIncrement(&pShard->Depth);
+        InterlockedPushEntrySList(&pShard->ListHead, &Shell->ListEntry);
+    }
+}
+
+_Must_inspect_result_
+NTSTATUS
+FxIoTarget::EnableCompletionQueue(
+    __in ULONG Capacity,
+    __in_opt PFN_FX_IO_TARGET_COMPLETION_QUEUE_NOTIFY Notify,
+    __in_opt PVOID NotifyContext
+    )
+/*++
+
+Routine Description:
+    Switches the target to queued completion.  From now on requests sent
+    asynchronously to the target are not completed from the irp completion
+    routine, they are appended to a ring and completed, completion routine
+    and all, when the owner calls DrainCompletionQueue.  A queued request
+    stays on the sent list until then, so stopping, purging or removing the
+    target waits for its completion routine like for any other sent request.
+    Synchronous sends and requests completed by cancellation still complete
+    inline, as do completions which find the ring full.
+
+Arguments:
+    Capacity - number of completions the ring can hold, rounded up to a
+        power of two
+
+    Notify - optional, called when the oldest queued completion is ready and
+        no drain in progress is known to pick it up
+
+    NotifyContext - context passed to Notify
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    FxIoCompletionRing* pRing;
+    ULONG size;
+
+    pFxDriverGlobals = GetDriverGlobals();
+
+    if (Capacity == 0 || Capacity > FX_IO_COMPLETION_QUEUE_MAX_CAPACITY) {
+        DoTraceLevelMessage(
+            pFxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "WDFIOTARGET %p, invalid completion queue capacity %d",
+            GetObjectHandle(), Capacity);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    for (size = 1; size < Capacity; size <<= 1) {
+        DO_NOTHING();
+    }
+
+    pRing = (FxIoCompletionRing*) FxPoolAllocate(
+        pFxDriverGlobals,
+        NonPagedPool,
+        FIELD_OFFSET(FxIoCompletionRing, Slots) + size * sizeof(FxRequestBase*));
+
+    if (pRing == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(pRing,
+                  FIELD_OFFSET(FxIoCompletionRing, Slots) +
+                      size * sizeof(FxRequestBase*));
+    pRing->Mask = size - 1;
+    pRing->Notify = Notify;
+    pRing->NotifyContext = NotifyContext;
+
+    if (InterlockedCompareExchangePointer((PVOID*) &m_CompletionRing,
+                                          pRing,
+                                          NULL) != NULL) {
+        FxPoolFree(pRing);
+
+        DoTraceLevelMessage(
+            pFxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "WDFIOTARGET %p completion queue already enabled",
+            GetObjectHandle());
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN
+FxIoTarget::QueueCompletion(
+    __in FxRequestBase* Request
+    )
+/*++
+
+Routine Description:
+    Appends a completed request to the completion ring.  Lock free, may be
+    called concurrently from any number of completion routines.
+
+Arguments:
+    Request - request which would otherwise be completed inline
+
+Return Value:
+    TRUE if the request was queued, FALSE if it must be completed inline
+    because queued completion is off or the ring is full.
+
+  --*/
+{
+    FxIoCompletionRing* pRing;
+    BOOLEAN queued;
+    LONG tail;
+
+    pRing = m_CompletionRing;
+    if (pRing == NULL) {
+        return FALSE;
+    }
+
+    queued = FALSE;
+
+    //
+    // Once the slot is published the request may be drained and its io count
+    // dropped at any time.  Hold one of our own so that the target cannot be
+    // disposed of while we still look at the ring and notify.
+    //
+    IncrementIoCount();
+
+    for (;;) {
+        tail = pRing->Tail;
+
+        if ((ULONG) (tail - pRing->Head) > pRing->Mask) {
+            goto Done;
+        }
+
+        if (InterlockedCompareExchange(&pRing->Tail, tail + 1, tail) == tail) {
+            break;
+        }
+    }
+
+    InterlockedExchangePointer((PVOID*) &pRing->Slots[tail & pRing->Mask],
+                               Request);
+    queued = TRUE;
+
+    //
+    // Head is read again only after the slot has been published.  A drain
+    // stops at the first unpublished slot, so if Head is still at our slot the
+    // drain has given up on it and will not come back on its own.  If Head is
+    // anywhere before our slot, the drain which moves it sees the published
+    // slot.  A drain which is still finishing up when we notify is covered by
+    // the check DrainCompletionQueue makes after it lets go of the ring.
+    //
+    if (pRing->Head == tail && pRing->Notify != NULL) {
+        pRing->Notify(this, pRing->NotifyContext);
+    }
+
+Done:
+    DecrementIoCount();
+
+    return queued;
+}
+
+ULONG
+FxIoTarget::DrainCompletionQueue(
+    __in ULONG MaxCount
+    )
+/*++
+
+Routine Description:
+    Completes up to MaxCount queued requests in the order they completed.
+    The requests are taken off the sent list under one acquisition of the
+    target lock and then completed.  Only one thread drains at a time, a
+    concurrent call returns 0.
+
+Arguments:
+    MaxCount - maximum number of requests to complete
+
+Return Value:
+    Number of requests completed
+
+  --*/
+{
+    FxIoCompletionRing* pRing;
+    FxRequestBase* pRequest;
+    LIST_ENTRY completed;
+    PLIST_ENTRY ple;
+    BOOLEAN setStopEvent;
+    ULONG count, i;
+    KIRQL irql;
+    LONG head;
+
+    pRing = m_CompletionRing;
+    if (pRing == NULL) {
+        return 0;
+    }
+
+    if (InterlockedCompareExchange(&pRing->Draining, 1, 0) != 0) {
+        return 0;
+    }
+
+    InitializeListHead(&completed);
+    setStopEvent = FALSE;
+
+    Lock(&irql);
+
+    for (count = 0; count < MaxCount; count++) {
+        head = pRing->Head;
+
+        if (head == pRing->Tail) {
+            break;
+        }
+
+        //
+        // A NULL slot has been reserved but not published yet, it is picked
+        // up by the next drain.
+        //
+        pRequest = (FxRequestBase*) InterlockedExchangePointer(
+            (PVOID*) &pRing->Slots[head & pRing->Mask], NULL);
+        if (pRequest == NULL) {
+            break;
+        }
+
+        InterlockedExchange(&pRing->Head, head + 1);
+
+        if (RemoveCompletedRequestLocked(pRequest)) {
+            setStopEvent = TRUE;
+        }
+
+        InsertTailList(&completed, &pRequest->m_ListEntry);
+    }
+
+    Unlock(irql);
+
+    while (!IsListEmpty(&completed)) {
+        ple = RemoveHeadList(&completed);
+        InitializeListHead(ple);
+
+        CompleteRequest(FxRequestBase::_FromListEntry(ple));
+    }
+
+    if (setStopEvent) {
+        DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIOTARGET,
+                            "WDFIOTARGET %p, setting stop event %p",
+                            GetObjectHandle(), m_SentIoEvent.GetEvent());
+        m_SentIoEvent.Set();
+    }
+
+    InterlockedExchange(&pRing->Draining, 0);
+
+    //
+    // A producer which published while this drain was finishing up had its
+    // notification turned away by the Draining check above, and a drain cut
+    // short by MaxCount leaves ready work behind.  Ask for another drain if
+    // the oldest slot is ready.  A producer publishing after this check finds
+    // the ring idle and notifies by itself.
+    //
+    head = pRing->Head;
+
+    if (pRing->Notify != NULL &&
+        head != pRing->Tail &&
+        pRing->Slots[head & pRing->Mask] != NULL) {
+        pRing->Notify(this, pRing->NotifyContext);
+    }
+
+    //
+    // Drop the io counts last, the target may be disposed of as soon as the
+    // last one is gone.
+    //
+    for (i = 0; i < count; i++) {
+        DecrementIoCount();
+    }
+
+    return count;
+}
+
+VOID
+FxIoTarget::FlushCompletionQueue(
+    VOID
+    )
+/*++
+
+Routine Description:
+    Called at passive level once the target's io count has dropped to zero
+    while it is disposed.  Every queued completion has been delivered by
+    then, and nothing can notify anymore.  Waits for a drain DPC which may
+    still be queued or on its way out before the target goes away.
+
+  --*/
+{
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    FxIoCompletionRing* pRing;
+
+    pRing = m_CompletionRing;
+
+    if (pRing != NULL && pRing->Notify == _CompletionQueueNotify) {
+        ASSERT(pRing->Head == pRing->Tail);
+        KeFlushQueuedDpcs();
+    }
+#endif
+}
+
 _Must_inspect_result_
 NTSTATUS
 FxIoTarget::SubmitSync(
     __in FxRequestBase* Request,
     __in_opt PWDF_REQUEST_SEND_OPTIONS Options,
-    __out_opt PULONG Action
+    __out_opt PULONG Action,
+    __in_opt FxSyncRequestShell* Shell
     )
 {
     FxTargetSubmitSyncParams params = {0};
+    FxSyncRequestShell* pShell;
     LONGLONG timeout;
     ULONG action;
     NTSTATUS status;
@@ -1671,13 +2166,29 @@ FxIoTarget::SubmitSync(
                         "WDFIOTARGET %p, WDFREQUEST %p",
                         GetObjectHandle(), Request->GetTraceObjectHandle());
 
+    //
+    // Wait on a pooled event when one is available so that UMDF does not
+    // create an event for every synchronous send.  A caller whose
+    // FxSyncRequest already borrowed a shell from this target lends it, so
+    // that a send takes a single shell.
+    //
+    pShell = (Shell != NULL) ? Shell : AcquireSyncShell(FALSE);
+    if (pShell != NULL) {
+        params.Event = pShell->Event.GetSelfPointer();
+    }
+    else {
+        params.Event = params.SynchEvent.GetSelfPointer();
+    }
+
 #if (FX_CORE_MODE == FX_CORE_USER_MODE)
     //
     // FxCREvent events needs to be initiliazed in UMDF, and failure handled
     // gracefully. For KMDF, it will result in double initialization which is
     // not a problem. Note that for KMDF, FxCREvent->Initialize will never fail. 
     //
-    status = params.SynchEvent.Initialize();
+    if (pShell == NULL) {
+        status = params.SynchEvent.Initialize();
+    }
     if (!NT_SUCCESS(status)) {
         DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
                             "Failed to initialize sync event for "
@@ -1836,7 +2347,7 @@ FxIoTarget::SubmitSync(
 
     if (action & SubmitSent) {
         if (action & SubmitWait) {
-            status = params.SynchEvent.EnterCRAndWaitAndLeave(
+            status = params.Event->EnterCRAndWaitAndLeave(
                 (action & SubmitTimeout) ? &timeout : NULL
                 );
 
@@ -1852,7 +2363,7 @@ FxIoTarget::SubmitSync(
 
                 Request->Cancel();
 
-                params.SynchEvent.EnterCRAndWaitAndLeave();
+                params.Event->EnterCRAndWaitAndLeave();
             }
         }
 
@@ -1864,6 +2375,17 @@ FxIoTarget::SubmitSync(
 
     Request->RELEASE(&status);
 
+    if (Shell != NULL) {
+        //
+        // The lender's FxSyncRequest waits on the same event for its last
+        // reference.  The send is over, nothing sets the event for it anymore.
+        //
+        Shell->Event.Clear();
+    }
+    else if (pShell != NULL) {
+        ReleaseSyncShell(pShell);
+    }
+
     if (Action != NULL) {
         *Action = action;
     }
@@ -2323,7 +2845,7 @@ Return Value:
   --*/
 {
     KIRQL irql;
-    BOOLEAN completeRequest, setStopEvent;
+    BOOLEAN completeRequest, setStopEvent, queueRequest;
 
     DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIOTARGET,
                         "WDFREQUEST %p", Request->GetTraceObjectHandle());
@@ -2331,6 +2853,7 @@ Return Value:
 
     setStopEvent = FALSE;
     completeRequest = FALSE;
+    queueRequest = FALSE;
 
     Lock(&irql);
 
@@ -2372,7 +2895,16 @@ Return Value:
             Request->m_Irp.SetStatus(STATUS_IO_TIMEOUT);
         }
 
-        setStopEvent = RemoveCompletedRequestLocked(Request);
+        if (m_CompletionRing != NULL &&
+            Request->m_CompletionRoutine.m_Completion != _SyncCompletionRoutine) {
+            //
+            // The request stays on the sent list until it is drained
+            //
+            queueRequest = TRUE;
+        }
+        else {
+            setStopEvent = RemoveCompletedRequestLocked(Request);
+        }
     }
     else {
         DoTraceLevelMessage(
@@ -2383,6 +2915,21 @@ Return Value:
 
     Unlock(irql);
 
+    if (queueRequest) {
+        if (QueueCompletion(Request)) {
+            //
+            // DrainCompletionQueue takes the request off the sent list,
+            // completes it and drops its io count
+            //
+            completeRequest = FALSE;
+        }
+        else {
+            Lock(&irql);
+            setStopEvent = RemoveCompletedRequestLocked(Request);
+            Unlock(irql);
+        }
+    }
+
     if (completeRequest) {
         DoTraceLevelMessage(GetDriverGlobals(), TRACE_LEVEL_VERBOSE, TRACINGIOTARGET,
                             "WDFREQUEST %p completed in completion routine",
@@ -2611,7 +3158,7 @@ FxIoTarget::_SyncCompletionRoutine(
             );
     }
 
-    pParams->SynchEvent.Set();
+    pParams->Event->Set();
 }
 
 
@@ -752,7 +752,7 @@ Return Value:
     FxIoContext context;
     FxSyncRequest request(FxDriverGlobals, &context, Request);
 
-    status = request.Initialize();
+    status = request.Initialize(pTarget);
     if (!NT_SUCCESS(status)) {
         DoTraceLevelMessage(FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
                             "Failed to initialize FxSyncRequest for WDFIOTARGET "
@@ -807,7 +807,10 @@ Return Value:
                             "WDFIOTARGET 0x%p, WDFREQUEST 0x%p being submitted",
                             IoTarget, request.m_TrueRequest->GetTraceObjectHandle());
 
-        status = pTarget->SubmitSync(request.m_TrueRequest, RequestOptions);
+        status = pTarget->SubmitSync(request.m_TrueRequest,
+                                     RequestOptions,
+                                     NULL,
+                                     request.m_Shell);
 
         if (BytesReturned != NULL) {
             *BytesReturned = request.m_TrueRequest->GetSubmitFxIrp()->GetInformation();
@@ -1132,7 +1135,7 @@ Return Value:
     FxIoContext context;
     FxSyncRequest request(FxDriverGlobals, &context, Request);
 
-    status = request.Initialize();
+    status = request.Initialize(pTarget);
     if (!NT_SUCCESS(status)) {
         DoTraceLevelMessage(FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
                             "Failed to initialize FxSyncRequest for WDFIOTARGET "
@@ -1199,7 +1202,10 @@ Return Value:
                             IoTarget,
                             request.m_TrueRequest->GetTraceObjectHandle());
 
-        status = pTarget->SubmitSync(request.m_TrueRequest, RequestOptions);
+        status = pTarget->SubmitSync(request.m_TrueRequest,
+                                     RequestOptions,
+                                     NULL,
+                                     request.m_Shell);
 
         if (BytesReturned != NULL) {
             *BytesReturned = request.m_TrueRequest->GetSubmitFxIrp()->GetInformation();
@@ -1603,7 +1609,7 @@ Return Value:
     FxInternalIoctlOthersContext context;
     FxSyncRequest request(pFxDriverGlobals, &context, Request);
 
-    status = request.Initialize();
+    status = request.Initialize(pTarget);
     if (!NT_SUCCESS(status)) {
         DoTraceLevelMessage(pFxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
                             "Failed to initialize FxSyncRequest for WDFIOTARGET "
@@ -1690,7 +1696,10 @@ Return Value:
                             IoTarget,
                             request.m_TrueRequest->GetTraceObjectHandle());
 
-        status = pTarget->SubmitSync(request.m_TrueRequest, RequestOptions);
+        status = pTarget->SubmitSync(request.m_TrueRequest,
+                                     RequestOptions,
+                                     NULL,
+                                     request.m_Shell);
 
         if (BytesReturned != NULL) {
             *BytesReturned = request.m_TrueRequest->GetSubmitFxIrp()->GetInformation();
@@ -29,6 +29,289 @@ extern "C" {
 #endif
 }
 
+static const USHORT FxIoBounceBufferClassSizes[FX_IO_BOUNCE_BUFFER_CLASSES] = {
+    512, 1024, 2048, FX_IO_BOUNCE_BUFFER_MAX_SIZE
+};
+
+__inline
+ULONG
+FxIoBounceBufferGetClass(
+    __in size_t Length
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < FX_IO_BOUNCE_BUFFER_CLASSES; i++) {
+        if (Length <= FxIoBounceBufferClassSizes[i]) {
+            return i;
+        }
+    }
+
+    return FX_IO_BOUNCE_BUFFER_CLASSES;
+}
+
+__inline
+FxIoBounceBufferList*
+FxIoBounceBufferGetList(
+    __in FxIoBounceBufferCache* Cache,
+    __in ULONG Class
+    )
+{
+    ULONG shard;
+
+    shard = Mx::MxGetCurrentProcessorNumber() &
+                (FX_IO_BOUNCE_BUFFER_SHARDS - 1);
+
+    return &Cache->Shards[shard].Classes[Class];
+}
+
+_Must_inspect_result_
+PVOID
+FxIoTarget::AllocateBounceBuffer(
+    __in ULONG Length,
+    __out size_t* AllocatedLength,
+    __deref_out_opt FxIoBounceBufferCache** BufferCache
+    )
+/*++
+
+Routine Description:
+    Allocates a non paged buffer used to double buffer I/O formatted against
+    a WdfDeviceIoBuffered target.  Lengths which fit in a size class are
+    served from the current processor's free list of the target's bounce
+    buffer cache, larger lengths are allocated directly from pool.
+
+Arguments:
+    Length - minimum length of the buffer
+
+    AllocatedLength - actual length of the returned buffer
+
+    BufferCache - cache the buffer must be returned to, NULL if the buffer was
+        not allocated from a cache.  Passed to _FreeBounceBuffer.
+
+Return Value:
+    The buffer or NULL on failure
+
+  --*/
+{
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    FxIoBounceBufferCache* pCache;
+    FxIoBounceBufferList* pList;
+    PVOID pBuffer;
+    ULONG cls, i, j;
+
+    pFxDriverGlobals = GetDriverGlobals();
+
+    *AllocatedLength = Length;
+    *BufferCache = NULL;
+
+    cls = FxIoBounceBufferGetClass(Length);
+    if (cls == FX_IO_BOUNCE_BUFFER_CLASSES) {
+        return FxPoolAllocate(pFxDriverGlobals, NonPagedPool, Length);
+    }
+
+    pCache = m_BounceBufferCache;
+
+    if (pCache == NULL) {
+        pCache = (FxIoBounceBufferCache*) FxPoolAllocate(pFxDriverGlobals,
+                                                         NonPagedPool,
+                                                         sizeof(*pCache));
+        if (pCache == NULL) {
+            //
+            // Not fatal, the I/O can still be double buffered uncached.
+            //
+            return FxPoolAllocate(pFxDriverGlobals, NonPagedPool, Length);
+        }
+
+        pCache->References = 1;
+        pCache->Closed = FALSE;
+
+        for (i = 0; i < FX_IO_BOUNCE_BUFFER_SHARDS; i++) {
+            for (j = 0; j < FX_IO_BOUNCE_BUFFER_CLASSES; j++) {
+                InitializeSListHead(&pCache->Shards[i].Classes[j].ListHead);
+                pCache->Shards[i].Classes[j].Depth = 0;
+            }
+        }
+
+        if (InterlockedCompareExchangePointer((PVOID*) &m_BounceBufferCache,
+                                              pCache,
+                                              NULL) != NULL) {
+            //
+            // Another format raced with us and published its cache first.
+            //
+            FxPoolFree(pCache);
+            pCache = m_BounceBufferCache;
+        }
+    }
+
+    pList = FxIoBounceBufferGetList(pCache, cls);
+
+    pBuffer = InterlockedPopEntrySList(&pList->ListHead);
+    if (pBuffer != NULL) {
+        InterlockedDecrement(&pList->Depth);
+    }
+    else {
+        pBuffer = FxPoolAllocate(pFxDriverGlobals,
+                                 NonPagedPool,
+                                 FxIoBounceBufferClassSizes[cls]);
+        if (pBuffer == NULL) {
+            return NULL;
+        }
+    }
+
+    InterlockedIncrement(&pCache->References);
+
+    *AllocatedLength = FxIoBounceBufferClassSizes[cls];
+    *BufferCache = pCache;
+
+    return pBuffer;
+}
+
+VOID
+FxIoTarget::_FreeBounceBuffer(
+    __in_opt FxIoBounceBufferCache* BufferCache,
+    __in PVOID Buffer,
+    __in size_t Length
+    )
+/*++
+
+Routine Description:
+    Returns a buffer allocated by AllocateBounceBuffer.  The buffer is pushed
+    on the current processor's free list for its size class unless that list
+    is full or the owning target has been destroyed.
+
+Arguments:
+    BufferCache - cache returned by AllocateBounceBuffer, can be NULL
+
+    Buffer - buffer to free
+
+    Length - allocated length returned by AllocateBounceBuffer
+
+Return Value:
+    None
+
+  --*/
+{
+    FxIoBounceBufferList* pList;
+    ULONG cls;
+
+    if (BufferCache == NULL) {
+        FxPoolFree(Buffer);
+        return;
+    }
+
+    cls = FxIoBounceBufferGetClass(Length);
+    ASSERT(cls < FX_IO_BOUNCE_BUFFER_CLASSES &&
+           FxIoBounceBufferClassSizes[cls] == Length);
+
+    pList = FxIoBounceBufferGetList(BufferCache, cls);
+
+    if (BufferCache->Closed ||
+        pList->Depth >= FX_IO_BOUNCE_BUFFER_MAX_DEPTH) {
+        FxPoolFree(Buffer);
+    }
+    else {
+        InterlockedIncrement(&pList->Depth);
+        InterlockedPushEntrySList(&pList->ListHead, (PSLIST_ENTRY) Buffer);
+    }
+
+    _ReleaseBounceBufferCache(BufferCache);
+}
+
+VOID
+FxIoTarget::_ReleaseBounceBufferCache(
+    __in FxIoBounceBufferCache* BufferCache
+    )
+/*++
+
+Routine Description:
+    Drops a reference on the bounce buffer cache.  On the final release all
+    cached buffers and the cache itself are freed.
+
+Arguments:
+    BufferCache - cache to release
+
+Return Value:
+    None
+
+  --*/
+{
+    PSLIST_ENTRY pEntry;
+    ULONG i, j;
+
+    if (InterlockedDecrement(&BufferCache->References) != 0) {
+        return;
+    }
+
+    for (i = 0; i < FX_IO_BOUNCE_BUFFER_SHARDS; i++) {
+        for (j = 0; j < FX_IO_BOUNCE_BUFFER_CLASSES; j++) {
+            while ((pEntry = InterlockedPopEntrySList(
+                        &BufferCache->Shards[i].Classes[j].ListHead)) != NULL) {
+                FxPoolFree(pEntry);
+            }
+        }
+    }
+
+    FxPoolFree(BufferCache);
+}
+
+VOID
+FxIoTarget::_CompletionQueueNotify(
+    __in FxIoTarget* Target,
+    __in PVOID Context
+    )
+/*++
+
+Routine Description:
+    Completion queue notification for targets of drivers which opted in to
+    queued completion, schedules the target's drain DPC.
+
+Arguments:
+    Target - target whose completion queue has ready entries
+
+    Context - unused
+
+Return Value:
+    None
+
+  --*/
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    Mx::MxInsertQueueDpc(&Target->m_CompletionDpc, NULL, NULL);
+}
+
+__drv_functionClass(KDEFERRED_ROUTINE)
+__drv_maxIRQL(DISPATCH_LEVEL)
+__drv_minIRQL(DISPATCH_LEVEL)
+__drv_requiresIRQL(DISPATCH_LEVEL)
+__drv_sameIRQL
+VOID
+FxIoTarget::_CompletionQueueDpc(
+    __in struct _KDPC *Dpc,
+    __in_opt PVOID DeferredContext,
+    __in_opt PVOID SystemArgument1,
+    __in_opt PVOID SystemArgument2
+    )
+/*++
+
+Routine Description:
+    Delivers up to FX_IO_COMPLETION_QUEUE_DRAIN_BUDGET queued completions.
+    If more are ready, DrainCompletionQueue notifies again and the DPC is
+    requeued, so one busy target does not hold the processor indefinitely.
+
+  --*/
+{
+    FxIoTarget* pThis;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    pThis = (FxIoTarget*) DeferredContext;
+
+    (VOID) pThis->DrainCompletionQueue(FX_IO_COMPLETION_QUEUE_DRAIN_BUDGET);
+}
+
 _Must_inspect_result_
 NTSTATUS
 FxIoTarget::FormatIoRequest(
@@ -40,9 +323,11 @@ FxIoTarget::FormatIoRequest(
     )
 {
     FxIoContext* pContext;
+    FxIoBounceBufferCache* pBufferCache;
     PVOID pBuffer;
     NTSTATUS status;
     ULONG ioLength;
+    size_t bufferLength;
     BOOLEAN freeSysBuf;
     BOOLEAN setBufferAndLength;
     FxIrp* irp;
@@ -53,6 +338,8 @@ FxIoTarget::FormatIoRequest(
 
     freeSysBuf = FALSE;
     pBuffer = NULL;
+    pBufferCache = NULL;
+    bufferLength = 0;
 
     status = Request->ValidateTarget(this);
     if (!NT_SUCCESS(status)) {
@@ -110,6 +397,29 @@ FxIoTarget::FormatIoRequest(
 
         if (ioLength != 0) {
 
+            if (GetDriverGlobals()->FxIoTargetDirectBufferedIoOn &&
+                GetDriverGlobals()->IsVersionGreaterThanOrEqualTo(1,15) &&
+                IoBuffer->IsNonPagedWritableMemory()) {
+                //
+                // The driver opted in (IoTargetDirectBufferedIoOn under
+                // Parameters\Wdf).  The memory object is non paged and stays
+                // referenced by the context until the request completes, so
+                // there is no need to double buffer it.  Hand it to the
+                // target as the system buffer, any buffer kept by the
+                // context is left for reuse.
+                //
+                status = IoBuffer->GetBuffer(&pBuffer);
+                if (!NT_SUCCESS(status)) {
+                    DoTraceLevelMessage(
+                        GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+                        "Could not retrieve io buffer, %!STATUS!", status);
+                    break;
+                }
+
+                irp->SetSystemBuffer(pBuffer);
+                pContext->m_CopyBackToBuffer = FALSE;
+                break;
+            }
 
             if ((pContext->m_BufferToFreeLength >= ioLength) &&
                 (pContext->m_BufferToFree != NULL)) {
@@ -117,9 +427,9 @@ FxIoTarget::FormatIoRequest(
                     setBufferAndLength = FALSE;
             }
             else {
-                irp->SetSystemBuffer(FxPoolAllocate(GetDriverGlobals(),
-                                   NonPagedPool,
-                                   ioLength));
+                irp->SetSystemBuffer(AllocateBounceBuffer(ioLength,
+                                                          &bufferLength,
+                                                          &pBufferCache));
                 if (irp->GetSystemBuffer() == NULL) {
                     DoTraceLevelMessage(
                         GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
@@ -163,8 +473,9 @@ FxIoTarget::FormatIoRequest(
             //
             if (setBufferAndLength) {                
                 pContext->SetBufferAndLength(irp->GetSystemBuffer(),
-                                    ioLength,
-                                    (MajorCode == IRP_MJ_READ) ? TRUE : FALSE);
+                                    bufferLength,
+                                    (MajorCode == IRP_MJ_READ) ? TRUE : FALSE,
+                                    pBufferCache);
 
                 freeSysBuf = FALSE; // FxIoContext will free the buffer.
             }
@@ -265,7 +576,9 @@ FxIoTarget::FormatIoRequest(
     }
     else {
         if (freeSysBuf) {
-            FxPoolFree(irp->GetSystemBuffer());
+            _FreeBounceBuffer(pBufferCache,
+                              irp->GetSystemBuffer(),
+                              bufferLength);
             irp->SetSystemBuffer(NULL);
         }
 
@@ -287,9 +600,11 @@ FxIoTarget::FormatIoctlRequest(
     )
 {
     FxIoContext* pContext;
+    FxIoBounceBufferCache* pBufferCache;
     NTSTATUS status;
     PVOID pBuffer;
     ULONG inLength, outLength;
+    size_t bufferLength;
     BOOLEAN freeSysBuf;
     BOOLEAN setBufferAndLength;
     FxIrp* irp;
@@ -298,6 +613,8 @@ FxIoTarget::FormatIoctlRequest(
 
     irp = Request->GetSubmitFxIrp();
     freeSysBuf = FALSE;
+    pBufferCache = NULL;
+    bufferLength = 0;
 
     status = Request->ValidateTarget(this);
     if (!NT_SUCCESS(status)) {
@@ -370,9 +687,9 @@ FxIoTarget::FormatIoctlRequest(
                     setBufferAndLength = FALSE;
             }
             else {
-                irp->SetSystemBuffer(FxPoolAllocate(GetDriverGlobals(),
-                                   NonPagedPool,
-                                   allocationLength));
+                irp->SetSystemBuffer(AllocateBounceBuffer(allocationLength,
+                                                          &bufferLength,
+                                                          &pBufferCache));
                 if (irp->GetSystemBuffer() == NULL) {
                     DoTraceLevelMessage(
                         GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
@@ -411,8 +728,9 @@ FxIoTarget::FormatIoctlRequest(
             irp->SetUserBuffer(pBuffer);
             if (setBufferAndLength) {
                 pContext->SetBufferAndLength(irp->GetSystemBuffer(),
-                                             allocationLength,
-                                             outLength > 0  ? TRUE : FALSE);
+                                             bufferLength,
+                                             outLength > 0  ? TRUE : FALSE,
+                                             pBufferCache);
                 freeSysBuf = FALSE; // FxIoContext will free the buffer.
             } else {
                 pContext->m_CopyBackToBuffer = outLength > 0  ? TRUE : FALSE;
@@ -512,7 +830,9 @@ FxIoTarget::FormatIoctlRequest(
     }
     else {
         if (freeSysBuf) {
-            FxPoolFree(irp->GetSystemBuffer());
+            _FreeBounceBuffer(pBufferCache,
+                              irp->GetSystemBuffer(),
+                              bufferLength);
             irp->SetSystemBuffer(NULL);
         }
 
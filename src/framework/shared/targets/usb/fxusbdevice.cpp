@@ -388,6 +388,7 @@ FxUsbDevice::FxUsbDevice(
     m_BusInterfaceDereference = NULL;
     m_ConfigHandle = NULL;
     m_ConfigDescriptor = NULL;
+    m_ConfigIndex = NULL;
 
     m_MismatchedInterfacesInConfigDescriptor = FALSE;
 
@@ -441,6 +442,11 @@ FxUsbDevice::~FxUsbDevice()
         m_BusInterfaceDereference = NULL;
     }
 
+    if (m_ConfigIndex != NULL) {
+        FxPoolFree(m_ConfigIndex);
+        m_ConfigIndex = NULL;
+    }
+
     if (m_ConfigDescriptor != NULL) {
         FxPoolFree(m_ConfigDescriptor);
         m_ConfigDescriptor = NULL;
@@ -900,16 +906,13 @@ FxUsbDevice::CreateInterfaces(
     )
 {
     PFX_DRIVER_GLOBALS pFxDriverGlobals;
-    UCHAR descCountBitMap[UCHAR_MAX / sizeof(UCHAR)];
     PUSB_INTERFACE_DESCRIPTOR  pInterfaceDescriptor;
-    UCHAR iInterface, numFound;
+    UCHAR iInterface;
     NTSTATUS status;
     ULONG size;
-    ULONG totalLength;
 
     pFxDriverGlobals = GetDriverGlobals();
     status = STATUS_SUCCESS;
-    totalLength = m_ConfigDescriptor->wTotalLength;
 
     //
     // Make sure each PCOMMON_DESCRIPTOR_HEADER within the entire config descriptor is well formed. 
@@ -984,96 +987,81 @@ FxUsbDevice::CreateInterfaces(
     m_NumInterfaces = m_ConfigDescriptor->bNumInterfaces;
 
     //
-    // Iterate over the desciptors again, this time allocating an FxUsbInterface
-    // for each one and capturing the interface information.
+    // Flatten the config descriptor once.  Creating the settings, selecting a
+    // configuration and querying endpoints all work off of the index from
+    // here on.
     //
-    RtlZeroMemory(descCountBitMap, sizeof(descCountBitMap));
-    iInterface = 0;
-    numFound = 0;
+    ASSERT(m_ConfigIndex == NULL);
 
-    pInterfaceDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-        m_ConfigDescriptor,
-        m_ConfigDescriptor->wTotalLength,
-        m_ConfigDescriptor,
-        USB_INTERFACE_DESCRIPTOR_TYPE
-        );
-
-    while (pInterfaceDescriptor != NULL &&
-           iInterface < m_ConfigDescriptor->bNumInterfaces) {
-        //
-        // This function will retun false if the bit wasn't already set
-        //
-        if (FxBitArraySet(descCountBitMap,
-                          pInterfaceDescriptor->bInterfaceNumber) == FALSE) {
-            FxUsbInterface* pInterface;
+    status = FxUsbBuildConfigIndex(pFxDriverGlobals,
+                                   m_ConfigDescriptor,
+                                   &m_ConfigIndex);
+    if (!NT_SUCCESS(status)) {
+        goto Done;
+    }
 
-            pInterface = new (GetDriverGlobals(), WDF_NO_OBJECT_ATTRIBUTES)
-                FxUsbInterface(pFxDriverGlobals,
-                               this,
-                               pInterfaceDescriptor);
+    //
+    // Allocate an FxUsbInterface for each interface number, in the order the
+    // interfaces appear in the config descriptor, and capture the interface
+    // information.
+    //
+    for (iInterface = 0;
+         iInterface < m_ConfigIndex->NumInterfaces &&
+         iInterface < m_ConfigDescriptor->bNumInterfaces;
+         iInterface++) {
+        FxUsbInterface* pInterface;
 
-            if (pInterface == NULL) {
-                status = STATUS_INSUFFICIENT_RESOURCES;
-                DoTraceLevelMessage(
-                    GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
-                    "Could not allocate memory for interface object #%d, %!STATUS!",
-                    iInterface, status);
-                goto Done;
-            }
+        pInterfaceDescriptor = m_ConfigIndex->Interfaces[iInterface].FirstDescriptor;
 
-            status = pInterface->Commit(WDF_NO_OBJECT_ATTRIBUTES, NULL, this);
+        pInterface = new (GetDriverGlobals(), WDF_NO_OBJECT_ATTRIBUTES)
+            FxUsbInterface(pFxDriverGlobals,
+                           this,
+                           pInterfaceDescriptor);
 
-            //
-            // This should never fail
-            //
-            ASSERT(NT_SUCCESS(status));
+        if (pInterface == NULL) {
+            status = STATUS_INSUFFICIENT_RESOURCES;
+            DoTraceLevelMessage(
+                GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+                "Could not allocate memory for interface object #%d, %!STATUS!",
+                iInterface, status);
+            goto Done;
+        }
 
-            if (!NT_SUCCESS(status)) {
-                goto Done;
-            }
+        status = pInterface->Commit(WDF_NO_OBJECT_ATTRIBUTES, NULL, this);
 
-            status = pInterface->CreateSettings();
-            if (!NT_SUCCESS(status)) {
-                goto Done;
-            }
+        //
+        // This should never fail
+        //
+        ASSERT(NT_SUCCESS(status));
 
-#if (FX_CORE_MODE == FX_CORE_USER_MODE)
-            status = pInterface->SetWinUsbHandle();
-            if (!NT_SUCCESS(status)) {
-                goto Done;
-            }
-            
-            status = pInterface->MakeAndConfigurePipes(WDF_NO_OBJECT_ATTRIBUTES,
-                                                       pInterfaceDescriptor->bNumEndpoints);
-            if (!NT_SUCCESS(status)) {
-                goto Done;
-            }
-#endif
+        if (!NT_SUCCESS(status)) {
+            goto Done;
+        }
 
-            m_Interfaces[iInterface] = pInterface;
+        status = pInterface->CreateSettings();
+        if (!NT_SUCCESS(status)) {
+            goto Done;
+        }
 
-            iInterface++;
+#if (FX_CORE_MODE == FX_CORE_USER_MODE)
+        status = pInterface->SetWinUsbHandle();
+        if (!NT_SUCCESS(status)) {
+            goto Done;
         }
+        
+        status = pInterface->MakeAndConfigurePipes(WDF_NO_OBJECT_ATTRIBUTES,
+                                                   pInterfaceDescriptor->bNumEndpoints);
+        if (!NT_SUCCESS(status)) {
+            goto Done;
+        }
+#endif
 
-        pInterfaceDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-            m_ConfigDescriptor,
-            totalLength,
-            WDF_PTR_ADD_OFFSET(pInterfaceDescriptor,
-                               pInterfaceDescriptor->bLength),
-            USB_INTERFACE_DESCRIPTOR_TYPE
-            );
+        m_Interfaces[iInterface] = pInterface;
     }
 
     //
-    // We cannot check for the error case of
-    //
-    // pInterfaceDescriptor != NULL &&
-    //  iInterface == m_ConfigDescriptor->bNumInterfaces
-    //
-    // Because if there are multiple alternative settings for the last interface
-    // in the config descriptor, we will have hit the limit of interfaces
-    // (correctly), but have found another pInterfaceDescriptor (the next alt
-    // setting).
+    // Interface numbers beyond bNumInterfaces in the index are ignored rather
+    // than failed, a device may describe more interfaces than it reports.
     //
 
     //
@@ -1091,7 +1079,7 @@ FxUsbDevice::CreateInterfaces(
             "find any interface descriptors in config descriptor %p, %!STATUS!",
             m_NumInterfaces, m_ConfigDescriptor, status);
     }
-    else if (pInterfaceDescriptor != NULL && m_NumInterfaces == 0) {
+    else if (m_ConfigIndex->NumInterfaces > 0 && m_NumInterfaces == 0) {
         DoTraceLevelMessage(
             GetDriverGlobals(), TRACE_LEVEL_WARNING, TRACINGIOTARGET,
             "Config descriptor indicated there were 0 interfaces, but an interface "
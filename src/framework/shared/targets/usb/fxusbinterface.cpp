@@ -212,35 +212,22 @@ Return Value:
 
   --*/
 {
-    PUSB_INTERFACE_DESCRIPTOR  pDescriptor;
+    FxUsbConfigIndexInterface* pIndexed;
+    FxUsbConfigIndexSetting* pSetting;
     ULONG size;
     UCHAR i;
 
     //
-    // No need to validate the size of the interface descriptor since FxUsbDevice::CreateInterfaces
-    // has already done so
+    // FxUsbDevice::CreateInterfaces has already validated the interface
+    // descriptors and indexed the settings of every interface by alternate
+    // setting.
     //
-    pDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-        m_UsbDevice->m_ConfigDescriptor,
-        m_UsbDevice->m_ConfigDescriptor->wTotalLength,
-        m_UsbDevice->m_ConfigDescriptor,
-        USB_INTERFACE_DESCRIPTOR_TYPE
-        );
+    pIndexed = FxUsbConfigIndexGetInterface(m_UsbDevice->m_ConfigIndex,
+                                            m_InterfaceNumber);
+    ASSERT(pIndexed != NULL);
+
+    m_NumSettings = pIndexed->NumSettings;
 
-    //
-    // Calculate the number of settings for this interface
-    //
-    while (pDescriptor != NULL) {
-        if (m_InterfaceNumber == pDescriptor->bInterfaceNumber) {
-           m_NumSettings++;
-        }
-        pDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-            m_UsbDevice->m_ConfigDescriptor,
-            m_UsbDevice->m_ConfigDescriptor->wTotalLength,
-            WDF_PTR_ADD_OFFSET(pDescriptor, pDescriptor->bLength),
-            USB_INTERFACE_DESCRIPTOR_TYPE
-            );
-    }
     size =  sizeof(FxUsbInterfaceSetting) * m_NumSettings;
     m_Settings = (FxUsbInterfaceSetting *) FxPoolAllocate(
         GetDriverGlobals(), NonPagedPool, size);
@@ -258,44 +245,14 @@ Return Value:
 
     RtlZeroMemory(m_Settings, size);
 
-    //
-    // Add all the settings for this interface
-    //
-    pDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-        m_UsbDevice->m_ConfigDescriptor,
-        m_UsbDevice->m_ConfigDescriptor->wTotalLength,
-        m_UsbDevice->m_ConfigDescriptor,
-        USB_INTERFACE_DESCRIPTOR_TYPE
-        );
-
-    while (pDescriptor != NULL) {
-        if (m_InterfaceNumber == pDescriptor->bInterfaceNumber) {
-            if (pDescriptor->bAlternateSetting < m_NumSettings) {
-                m_Settings[pDescriptor->bAlternateSetting].InterfaceDescriptor = pDescriptor;
-            }
-            else {
-                DoTraceLevelMessage(
-                    GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
-                    "Interface Number %d does not have contiguous alternate settings,"
-                    "expected %d settings, found alt setting %d, %!STATUS!",
-                    pDescriptor->bInterfaceNumber, m_NumSettings,
-                    pDescriptor->bAlternateSetting, STATUS_INVALID_DEVICE_REQUEST);
-
-                return STATUS_INVALID_DEVICE_REQUEST;
-            }
-        }
-
-        pDescriptor = (PUSB_INTERFACE_DESCRIPTOR) FxUsbFindDescriptorType(
-            m_UsbDevice->m_ConfigDescriptor,
-            m_UsbDevice->m_ConfigDescriptor->wTotalLength,
-            WDF_PTR_ADD_OFFSET(pDescriptor, pDescriptor->bLength),
-            USB_INTERFACE_DESCRIPTOR_TYPE
-            );
-    }
-
     for (i = 0; i < m_NumSettings; i++) {
+        pSetting = &pIndexed->Settings[i];
 
-        if (m_Settings[i].InterfaceDescriptor == NULL) {
+        //
+        // A setting whose alternate setting number is out of range leaves a
+        // hole in the index, so both failures show up as a missing setting.
+        //
+        if (pSetting->InterfaceDescriptor == NULL) {
             DoTraceLevelMessage(
                 GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
                 "Interface Number %d does not have contiguous alternate settings,"
@@ -306,62 +263,7 @@ Return Value:
             return STATUS_INVALID_DEVICE_REQUEST;
         }
 
-        //
-        // Only validate the endpoints if the interface reports it has some. We don't
-        // want to validate EP descriptors that may be after the interface descriptor 
-        // that are never used because bNumEndpoints doesn't indicate they are present.
-        //
-        if (m_Settings[i].InterfaceDescriptor->bNumEndpoints > 0) {
-            PVOID pRelativeEnd;
-            NTSTATUS status;
-
-            // 
-            // Validate that each endpoint descriptor is the correct size for this alt setting. 
-            // We will use the next inteface descriptor as the end, and if this is the last 
-            // interface descriptor, use the end of the config descriptor as our end.
-            //
-            pRelativeEnd = FxUsbFindDescriptorType(
-                m_UsbDevice->m_ConfigDescriptor,
-                m_UsbDevice->m_ConfigDescriptor->wTotalLength,
-                m_Settings[i].InterfaceDescriptor,
-                USB_INTERFACE_DESCRIPTOR_TYPE
-                );
-
-            if (pRelativeEnd == NULL) {
-                //
-                // This is the last alt setting in the config descriptor, use the end of the 
-                // config descriptor as our end
-                //
-                pRelativeEnd = WDF_PTR_ADD_OFFSET(m_UsbDevice->m_ConfigDescriptor, 
-                    m_UsbDevice->m_ConfigDescriptor->wTotalLength);
-            }
-
-            // 
-            // Limit the number of endpoints validated to bNumEndpoints. In theory 
-            // there could be EP descriptors after N EP descriptors that are never
-            // used, thus we don't want to risk valdiating them and failing them
-            // (ie an app compat concern, in a perfect world we would validate them)
-            //
-            status = FxUsbValidateDescriptorType(
-                GetDriverGlobals(),
-                m_UsbDevice->m_ConfigDescriptor,
-                m_Settings[i].InterfaceDescriptor,
-                pRelativeEnd,
-                USB_ENDPOINT_DESCRIPTOR_TYPE,
-                sizeof(USB_ENDPOINT_DESCRIPTOR),
-                FxUsbValidateDescriptorOpAtLeast,
-                m_Settings[i].InterfaceDescriptor->bNumEndpoints
-                );
-
-            if (!NT_SUCCESS(status)) {
-                DoTraceLevelMessage(
-                    GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
-                    "Interface Number %d does not have a valid endpoint descriptor,"
-                    "%!STATUS!", m_InterfaceNumber, status);
-
-                return status;
-            }
-        }
+        m_Settings[i].InterfaceDescriptor = pSetting->InterfaceDescriptor;
     }
 
     return STATUS_SUCCESS;
@@ -859,8 +761,9 @@ FxUsbInterface::GetEndpointInformation(
 
 Routine Description:
     The layout of the config descriptor is such that each interface+setting pair
-    is followed by the endpoints for that interface+setting pair.  Keep track of
-    the index.
+    is followed by the endpoints for that interface+setting pair.  Those
+    endpoints were captured in the device's config descriptor index when the
+    interfaces were created, so this is a direct lookup.
 
 Arguments:
     SettingIndex - alternate setting to get info for
@@ -874,75 +777,23 @@ Return Value:
 
   --*/
 {
-    PUCHAR pEnd, pCur;
-    PUSB_INTERFACE_DESCRIPTOR pInterfaceDesc;
-    PUSB_ENDPOINT_DESCRIPTOR pEndpointDesc;
-    UCHAR curEndpointIndex;
-    BOOLEAN endPointFound;
-
-    pInterfaceDesc = NULL;
-    curEndpointIndex = 0;
-    endPointFound = FALSE;
+    FxUsbConfigIndexSetting* pSetting;
 
     //
-    // Extract the interface descriptor for the alternate setting for the interface
+    // The index holds the endpoints which follow the interface descriptor of
+    // each interface+setting pair, sizes already validated by CreateSettings()
     //
-    pInterfaceDesc = GetSettingDescriptor(SettingIndex);
+    pSetting = FxUsbConfigIndexGetSetting(m_UsbDevice->m_ConfigIndex,
+                                          m_InterfaceNumber,
+                                          SettingIndex);
 
-    if (pInterfaceDesc == NULL) {
+    if (pSetting == NULL || EndpointIndex >= pSetting->NumEndpoints) {
         return;
     }
 
-    pEnd = (PUCHAR) WDF_PTR_ADD_OFFSET(
-        m_UsbDevice->m_ConfigDescriptor,
-        m_UsbDevice->m_ConfigDescriptor->wTotalLength
-        );
-
-    //
-    // Start from the descriptor after current one
-    //
-    pCur = (PUCHAR) WDF_PTR_ADD_OFFSET(pInterfaceDesc, pInterfaceDesc->bLength);
-
-    //
-    // Iterate through the list of EP descriptors following the interface descriptor
-    // we just found and get the endpoint descriptor which matches the endpoint
-    // index or we hit another interface descriptor
-    //
-    // We have already validated that the descriptor headers are well formed and within
-    // the config descriptor bounds
-    //
-    while (pCur < pEnd) {
-        PUSB_COMMON_DESCRIPTOR pCommonDesc = (PUSB_COMMON_DESCRIPTOR) pCur;
-
-        //
-        // If we hit the next interface no way we can find the EndPoint
-        //
-        if (pCommonDesc->bDescriptorType == USB_INTERFACE_DESCRIPTOR_TYPE) {
-            break;
-        }
-
-        if (pCommonDesc->bDescriptorType == USB_ENDPOINT_DESCRIPTOR_TYPE) {
-            // 
-            // Size of pEndpointDesc has been validated by CreateSettings() and
-            // is within the config descriptor
-            //
-            pEndpointDesc = (PUSB_ENDPOINT_DESCRIPTOR) pCommonDesc;
-
-            if (EndpointIndex == curEndpointIndex) {
-                CopyEndpointFieldsFromDescriptor(PipeInfo,
-                                                 pEndpointDesc,
-                                                 SettingIndex);
-                break;
-            }
-
-            curEndpointIndex++;
-        }
-
-        //
-        // Advance past this descriptor
-        //
-        pCur +=  pCommonDesc->bLength;
-    }
+    CopyEndpointFieldsFromDescriptor(PipeInfo,
+                                     pSetting->Endpoints[EndpointIndex],
+                                     SettingIndex);
 }
 
 ULONG
@@ -1155,12 +1006,12 @@ Return Value:
 
   --*/
 {
-    UCHAR i;
-
-    for (i = 0; i < m_NumSettings; i++) {
-        if (m_Settings[i].InterfaceDescriptor->bAlternateSetting == Setting) {
-            return m_Settings[i].InterfaceDescriptor;
-        }
+    //
+    // CreateSettings() stored each setting at its alternate setting number
+    //
+    if (Setting < m_NumSettings) {
+        ASSERT(m_Settings[Setting].InterfaceDescriptor->bAlternateSetting == Setting);
+        return m_Settings[Setting].InterfaceDescriptor;
     }
 
     return NULL;
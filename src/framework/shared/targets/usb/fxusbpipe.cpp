@@ -1061,6 +1061,7 @@ FxUsbPipe::FxUsbPipe(
 #endif
     m_InterfaceNumber = 0;
     m_Reader = NULL;
+    m_WriteCoalescer = NULL;
     m_UsbInterface = NULL;
     m_CheckPacketSize = TRUE;
     m_USBDHandle = UsbDevice->m_USBDHandle;
@@ -1076,6 +1077,11 @@ FxUsbPipe::InitPipe(
     __in FxUsbInterface* UsbInterface
     )
 {
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    NTSTATUS status;
+#endif
+
     RtlCopyMemory(&m_PipeInformation, PipeInfo, sizeof(m_PipeInformation));
     m_InterfaceNumber = InterfaceNumber;
 
@@ -1086,6 +1092,32 @@ FxUsbPipe::InitPipe(
 
     m_UsbInterface = UsbInterface;
     m_UsbInterface->ADDREF(this);
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    pFxDriverGlobals = GetDriverGlobals();
+
+    //
+    // Drivers which opted in (UsbWriteCoalescingOn under Parameters\Wdf) get
+    // the transfers they send to bulk and interrupt OUT pipes merged.  The
+    // pipe is not visible to the driver yet, so nothing can race with the
+    // coalescer being set up.  Without it writes are simply sent as is.
+    //
+    if (pFxDriverGlobals->FxUsbWriteCoalescingOn &&
+        m_WriteCoalescer == NULL &&
+        (IsType(WdfUsbPipeTypeBulk) || IsType(WdfUsbPipeTypeInterrupt)) &&
+        IsOutEndpoint()) {
+
+        status = InitWriteCoalescer(
+            pFxDriverGlobals->FxUsbWriteCoalescingTransfers, 0);
+
+        if (!NT_SUCCESS(status)) {
+            DoTraceLevelMessage(
+                pFxDriverGlobals, TRACE_LEVEL_WARNING, TRACINGIOTARGET,
+                "WDFUSBPIPE %p will not coalesce writes, %!STATUS!",
+                GetHandle(), status);
+        }
+    }
+#endif
 }
 
 FxUsbPipe::~FxUsbPipe()
@@ -1125,6 +1157,11 @@ FxUsbPipe::Dispose()
         m_Reader = NULL;
     }
 
+    if (m_WriteCoalescer != NULL) {
+        delete m_WriteCoalescer;
+        m_WriteCoalescer = NULL;
+    }
+
     return callCleanup;
 }
 
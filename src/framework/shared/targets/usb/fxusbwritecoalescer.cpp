@@ -0,0 +1,968 @@
+//
+//    Copyright (C) Microsoft.  All rights reserved.
+//
+#include "fxusbpch.hpp"
+
+extern "C" {
+#include "FxUsbWriteCoalescer.tmh"
+}
+
+#include "Fxglobals.h"
+
+FxUsbPipeWriteCoalescer::FxUsbPipeWriteCoalescer(
+    __in FxUsbPipe* Pipe,
+    __in UCHAR NumBatches
+    ) :
+    m_NumBatches(NumBatches)
+{
+    m_Pipe = Pipe;
+
+    InitializeListHead(&m_PendingWrites);
+    m_StageEntry = &m_PendingWrites;
+
+    InitializeListHead(&m_FreeWrites);
+    m_WriteDescriptors = NULL;
+
+    m_StreamOffset = 0;
+    m_StagedOffset = 0;
+    m_TransferSize = 0;
+    m_Head = 0;
+    m_Next = 0;
+    m_Pumping = FALSE;
+    m_PumpRerun = FALSE;
+
+    RtlZeroMemory(&m_Batches[0], m_NumBatches * sizeof(FxUsbWriteBatch));
+}
+
+FxUsbPipeWriteCoalescer::~FxUsbPipeWriteCoalescer()
+{
+    FxUsbCoalescedWrite* pWrite;
+    FxIrp irp;
+    LONG i;
+
+    //
+    // Writes stay on the pipe's sent list until they are completed and the
+    // pipe has waited for all of its I/O, so every merged transfer has been
+    // retired and every write has been completed.  Should a write still be
+    // around, fail it rather than leave its irp pending forever.
+    //
+    ASSERT(IsListEmpty(&m_PendingWrites));
+
+    while (!IsListEmpty(&m_PendingWrites)) {
+        pWrite = CONTAINING_RECORD(RemoveHeadList(&m_PendingWrites),
+                                   FxUsbCoalescedWrite,
+                                   ListEntry);
+        InitializeListHead(&pWrite->ListEntry);
+
+        irp.SetIrp(pWrite->Irp);
+
+        if (pWrite->Cancelable && irp.SetCancelRoutine(NULL) == NULL) {
+            //
+            // The cancel routine owns the irp
+            //
+            continue;
+        }
+
+        _CompleteWrite(pWrite->Irp,
+                       pWrite->Urb,
+                       STATUS_CANCELLED,
+                       USBD_STATUS_CANCELED,
+                       0);
+
+        if (pWrite->Preallocated == FALSE) {
+            FxPoolFree(pWrite);
+        }
+    }
+
+    for (i = 0; i < m_NumBatches; i++) {
+        ASSERT(m_Batches[i].State == FxUsbWriteBatchFree);
+
+        if (m_Batches[i].Request != NULL) {
+            m_Batches[i].Request->DeleteObject();
+            m_Batches[i].Request = NULL;
+        }
+
+        if (m_Batches[i].Buffer != NULL) {
+            FxPoolFree(m_Batches[i].Buffer);
+            m_Batches[i].Buffer = NULL;
+        }
+    }
+
+    if (m_WriteDescriptors != NULL) {
+        FxPoolFree(m_WriteDescriptors);
+        m_WriteDescriptors = NULL;
+    }
+}
+
+PVOID
+FxUsbPipeWriteCoalescer::operator new(
+    __in size_t Size,
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __range(1, NUM_COALESCED_WRITES_MAX) ULONG NumBatches
+    )
+{
+    ASSERT(NumBatches >= 1);
+
+    return FxPoolAllocate(
+        FxDriverGlobals,
+        NonPagedPool,
+        Size + (NumBatches-1) * sizeof(FxUsbWriteBatch)
+        );
+}
+
+_Must_inspect_result_
+NTSTATUS
+FxUsbPipeWriteCoalescer::Config(
+    __in ULONG TransferSize
+    )
+/*++
+
+Routine Description:
+    Sizes the merged transfers and allocates a request and a buffer for each
+    of them, along with the preallocated write descriptors.
+
+Arguments:
+    TransferSize - requested size of a merged transfer, 0 for the device's
+        default max transfer size.  It is capped at that size and rounded
+        down to a multiple of the max packet size so that only the last
+        packet of a merged transfer can be short.
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    PFX_DRIVER_GLOBALS pFxDriverGlobals;
+    ULONG maxTransferSize, packetSize;
+    NTSTATUS status;
+    LONG i;
+
+    pFxDriverGlobals = m_Pipe->GetDriverGlobals();
+
+    maxTransferSize = m_Pipe->m_UsbDevice->GetDefaultMaxTransferSize();
+    packetSize = m_Pipe->GetMaxPacketSize();
+
+    if (TransferSize == 0 || TransferSize > maxTransferSize) {
+        TransferSize = maxTransferSize;
+    }
+
+    if (packetSize != 0) {
+        TransferSize -= TransferSize % packetSize;
+
+        if (TransferSize == 0) {
+            TransferSize = packetSize;
+        }
+    }
+
+    m_TransferSize = TransferSize;
+
+    for (i = 0; i < m_NumBatches; i++) {
+        m_Batches[i].Parent = this;
+        m_Batches[i].State = FxUsbWriteBatchFree;
+
+        status = FxRequest::_Create(pFxDriverGlobals,
+                                    WDF_NO_OBJECT_ATTRIBUTES,
+                                    NULL,
+                                    m_Pipe,
+                                    FxRequestOwnsIrp,
+                                    FxRequestConstructorCallerIsFx,
+                                    &m_Batches[i].Request);
+        if (!NT_SUCCESS(status)) {
+            return status;
+        }
+
+        m_Batches[i].Buffer = FxPoolAllocate(pFxDriverGlobals,
+                                             NonPagedPool,
+                                             m_TransferSize);
+        if (m_Batches[i].Buffer == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    m_WriteDescriptors = (FxUsbCoalescedWrite*) FxPoolAllocate(
+        pFxDriverGlobals,
+        NonPagedPool,
+        NUM_COALESCED_WRITE_DESCRIPTORS * sizeof(FxUsbCoalescedWrite));
+
+    if (m_WriteDescriptors == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(m_WriteDescriptors,
+                  NUM_COALESCED_WRITE_DESCRIPTORS * sizeof(FxUsbCoalescedWrite));
+
+    for (i = 0; i < NUM_COALESCED_WRITE_DESCRIPTORS; i++) {
+        m_WriteDescriptors[i].Parent = this;
+        m_WriteDescriptors[i].Preallocated = TRUE;
+
+        InsertTailList(&m_FreeWrites, &m_WriteDescriptors[i].ListEntry);
+    }
+
+    DoTraceLevelMessage(
+        pFxDriverGlobals, TRACE_LEVEL_VERBOSE, TRACINGIOTARGET,
+        "WDFUSBPIPE %p coalescing writes into %d transfers of %d bytes",
+        m_Pipe->GetHandle(), m_NumBatches, m_TransferSize);
+
+    return STATUS_SUCCESS;
+}
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+VOID
+FxUsbPipeWriteCoalescer::Write(
+    __in MdIrp Irp,
+    __in _URB_BULK_OR_INTERRUPT_TRANSFER* Urb,
+    __in_bcount(Length) PVOID Buffer,
+    __in ULONG Length
+    )
+/*++
+
+Routine Description:
+    Accepts a transfer irp formatted for the pipe.  The coalescer owns Irp
+    from here on, its stack location has already been set by the caller, and
+    completes it with the number of bytes written once all of its data has
+    been sent, or with an error.  Writes larger than a merged transfer are
+    split across several of them.  A write which has to wait for a free
+    merged transfer is cancelable until its data starts being copied.
+
+Arguments:
+    Irp - the client's transfer irp
+
+    Urb - bulk or interrupt OUT transfer URB formatted in Irp
+
+    Buffer - system address of the data to write
+
+    Length - number of bytes to write, not zero
+
+  --*/
+{
+    FxUsbCoalescedWrite* pWrite;
+    FxIrp irp(Irp);
+    KIRQL irql;
+
+    ASSERT(Length != 0);
+
+    m_Lock.Acquire(&irql);
+
+    if (IsListEmpty(&m_FreeWrites)) {
+        m_Lock.Release(irql);
+
+        pWrite = (FxUsbCoalescedWrite*) FxPoolAllocate(
+            m_Pipe->GetDriverGlobals(),
+            NonPagedPool,
+            sizeof(FxUsbCoalescedWrite));
+
+        if (pWrite == NULL) {
+            _CompleteWrite(Irp,
+                           Urb,
+                           STATUS_INSUFFICIENT_RESOURCES,
+                           USBD_STATUS_INSUFFICIENT_RESOURCES,
+                           0);
+            return;
+        }
+
+        pWrite->Parent = this;
+        pWrite->Preallocated = FALSE;
+
+        m_Lock.Acquire(&irql);
+    }
+    else {
+        pWrite = CONTAINING_RECORD(RemoveHeadList(&m_FreeWrites),
+                                   FxUsbCoalescedWrite,
+                                   ListEntry);
+    }
+
+    pWrite->Irp = Irp;
+    pWrite->Urb = Urb;
+    pWrite->Buffer = Buffer;
+    pWrite->Length = Length;
+    pWrite->Copied = 0;
+    pWrite->Status = STATUS_SUCCESS;
+    pWrite->UsbdStatus = USBD_STATUS_SUCCESS;
+    pWrite->Cancelable = FALSE;
+
+    m_StreamOffset += Length;
+    pWrite->End = m_StreamOffset;
+
+    InsertTailList(&m_PendingWrites, &pWrite->ListEntry);
+
+    if (m_StageEntry == &m_PendingWrites) {
+        m_StageEntry = &pWrite->ListEntry;
+    }
+
+    //
+    // Unless the pump below copies the write into a free merged transfer
+    // right away, the write waits in the backlog and must be cancelable, the
+    // way it would be in the queue of the driver below the pipe.
+    //
+    if (m_Pumping ||
+        m_StageEntry != &pWrite->ListEntry ||
+        m_Batches[m_Next].State != FxUsbWriteBatchFree) {
+
+        irp.SetContext(FX_USB_COALESCED_WRITE_CONTEXT_ENTRY, pWrite);
+        pWrite->Cancelable = TRUE;
+
+        irp.SetCancelRoutine(_FxUsbCoalescedWriteCancel);
+
+        if (irp.IsCanceled() && irp.SetCancelRoutine(NULL) != NULL) {
+            //
+            // Canceled before the cancel routine was set.  If the routine
+            // was set in time it runs once we let go of the lock instead.
+            //
+            pWrite->Cancelable = FALSE;
+            irp.SetContext(FX_USB_COALESCED_WRITE_CONTEXT_ENTRY, NULL);
+
+            RemoveUnstagedWriteLocked(pWrite);
+            FreeWriteLocked(pWrite);
+
+            m_Lock.Release(irql);
+
+            _CompleteWrite(Irp, Urb, STATUS_CANCELLED, USBD_STATUS_CANCELED, 0);
+            return;
+        }
+    }
+
+    PumpAndUnlock(irql);
+}
+#endif
+
+BOOLEAN
+FxUsbPipeWriteCoalescer::IsBatchIrp(
+    __in MdIrp Irp
+    )
+/*++
+
+Routine Description:
+    Tells whether Irp is one of the coalescer's own merged transfers, which
+    must go down to the device as is.
+
+  --*/
+{
+    LONG i;
+
+    for (i = 0; i < m_NumBatches; i++) {
+        if (m_Batches[i].Request != NULL &&
+            m_Batches[i].Request->GetSubmitIrp() == Irp) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+VOID
+FxUsbPipeWriteCoalescer::Pump(
+    __in FxUsbWriteBatch* Batch,
+    __in NTSTATUS Status,
+    __in USBD_STATUS UsbdStatus
+    )
+/*++
+
+Routine Description:
+    Records a completed merged transfer and pumps the coalescer.
+
+Arguments:
+    Batch, Status, UsbdStatus - merged transfer which completed and its
+        status
+
+  --*/
+{
+    KIRQL irql;
+
+    m_Lock.Acquire(&irql);
+
+    ASSERT(Batch->State == FxUsbWriteBatchSent);
+    Batch->Status = Status;
+    Batch->UsbdStatus = UsbdStatus;
+    Batch->State = FxUsbWriteBatchDone;
+
+    PumpAndUnlock(irql);
+}
+
+VOID
+FxUsbPipeWriteCoalescer::PumpAndUnlock(
+    __in __drv_restoresIRQL KIRQL PreviousIrql
+    )
+/*++
+
+Routine Description:
+    Retires completed transfers in order, refills free transfers with queued
+    data and sends them.  Only one thread pumps at a time.  A caller which
+    finds another thread pumping, including a transfer completing inline on
+    the pumping thread, leaves its work to that thread, so the stack never
+    grows with the number of transfers sent.
+
+    Called with m_Lock held, returns with it released.
+
+Arguments:
+    PreviousIrql - IRQL m_Lock was acquired at
+
+  --*/
+{
+    FxUsbWriteBatch* batches[NUM_COALESCED_WRITES_MAX];
+    FxUsbCoalescedWrite* pWrite;
+    LIST_ENTRY completed;
+    PLIST_ENTRY ple;
+    NTSTATUS status;
+    ULONG count, i;
+    KIRQL irql;
+
+    irql = PreviousIrql;
+
+    if (m_Pumping) {
+        m_PumpRerun = TRUE;
+        m_Lock.Release(irql);
+        return;
+    }
+
+    m_Pumping = TRUE;
+
+    InitializeListHead(&completed);
+
+    do {
+        m_PumpRerun = FALSE;
+
+        RetireBatchesLocked(&completed);
+        count = FillBatchesLocked(batches);
+
+        m_Lock.Release(irql);
+
+        //
+        // The descriptors stay on the completed list and are freed once the
+        // lock is reacquired.
+        //
+        for (ple = completed.Flink; ple != &completed; ple = ple->Flink) {
+            pWrite = CONTAINING_RECORD(ple, FxUsbCoalescedWrite, ListEntry);
+
+            _CompleteWrite(pWrite->Irp,
+                           pWrite->Urb,
+                           pWrite->Status,
+                           pWrite->UsbdStatus,
+                           NT_SUCCESS(pWrite->Status) ? pWrite->Length : 0);
+        }
+
+        for (i = 0; i < count; i++) {
+            status = SendBatch(batches[i]);
+
+            if (!NT_SUCCESS(status)) {
+                m_Lock.Acquire(&irql);
+                batches[i]->Status = status;
+                batches[i]->State = FxUsbWriteBatchDone;
+                m_PumpRerun = TRUE;
+                m_Lock.Release(irql);
+            }
+        }
+
+        m_Lock.Acquire(&irql);
+
+        while (!IsListEmpty(&completed)) {
+            ple = RemoveHeadList(&completed);
+            FreeWriteLocked(CONTAINING_RECORD(ple,
+                                              FxUsbCoalescedWrite,
+                                              ListEntry));
+        }
+    } while (m_PumpRerun);
+
+    m_Pumping = FALSE;
+
+    m_Lock.Release(irql);
+}
+
+VOID
+FxUsbPipeWriteCoalescer::RemoveUnstagedWriteLocked(
+    __in FxUsbCoalescedWrite* Write
+    )
+/*++
+
+Routine Description:
+    Drops a write none of whose data has been copied from the write stream.
+    Later writes move up in the stream by its length.
+
+  --*/
+{
+    FxUsbCoalescedWrite* pWrite;
+    PLIST_ENTRY ple;
+
+    ASSERT(Write->Copied == 0);
+
+    for (ple = Write->ListEntry.Flink;
+         ple != &m_PendingWrites;
+         ple = ple->Flink) {
+
+        pWrite = CONTAINING_RECORD(ple, FxUsbCoalescedWrite, ListEntry);
+        pWrite->End -= Write->Length;
+    }
+
+    m_StreamOffset -= Write->Length;
+
+    if (m_StageEntry == &Write->ListEntry) {
+        m_StageEntry = Write->ListEntry.Flink;
+    }
+
+    RemoveEntryList(&Write->ListEntry);
+    InitializeListHead(&Write->ListEntry);
+}
+
+VOID
+FxUsbPipeWriteCoalescer::FreeWriteLocked(
+    __in FxUsbCoalescedWrite* Write
+    )
+{
+    Write->Irp = NULL;
+    Write->Urb = NULL;
+
+    if (Write->Preallocated) {
+        InsertHeadList(&m_FreeWrites, &Write->ListEntry);
+    }
+    else {
+        FxPoolFree(Write);
+    }
+}
+
+VOID
+FxUsbPipeWriteCoalescer::_CompleteWrite(
+    __in MdIrp Irp,
+    __in _URB_BULK_OR_INTERRUPT_TRANSFER* Urb,
+    __in NTSTATUS Status,
+    __in USBD_STATUS UsbdStatus,
+    __in ULONG Length
+    )
+/*++
+
+Routine Description:
+    Completes a write's irp the way the USB stack completes a transfer, with
+    the URB holding the USBD status and the number of bytes written.
+
+  --*/
+{
+    FxIrp irp(Irp);
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+    Urb->Hdr.Status = UsbdStatus;
+    Urb->TransferBufferLength = Length;
+#else
+    UNREFERENCED_PARAMETER(Urb);
+    UNREFERENCED_PARAMETER(UsbdStatus);
+    UNREFERENCED_PARAMETER(Length);
+#endif
+
+    irp.SetStatus(Status);
+    irp.SetInformation(0);
+    irp.CompleteRequest(IO_NO_INCREMENT);
+}
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+VOID
+FxUsbPipeWriteCoalescer::_FxUsbCoalescedWriteCancel(
+    __inout MdDeviceObject DeviceObject,
+    __in __drv_useCancelIRQL MdIrp Irp
+    )
+/*++
+
+Routine Description:
+    Cancels a write waiting in the backlog.  If the pump tried to take the
+    write back first, it has already dropped the write from the stream and
+    left the irp to this routine.
+
+  --*/
+{
+    FxUsbPipeWriteCoalescer* pThis;
+    FxUsbCoalescedWrite* pWrite;
+    _URB_BULK_OR_INTERRUPT_TRANSFER* pUrb;
+    FxIrp irp(Irp);
+    KIRQL irql;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    IoReleaseCancelSpinLock(irp.GetCancelIrql());
+
+    pWrite = (FxUsbCoalescedWrite*)
+        irp.GetContext(FX_USB_COALESCED_WRITE_CONTEXT_ENTRY);
+    irp.SetContext(FX_USB_COALESCED_WRITE_CONTEXT_ENTRY, NULL);
+
+    pThis = pWrite->Parent;
+    pUrb = pWrite->Urb;
+
+    pThis->m_Lock.Acquire(&irql);
+
+    if (pWrite->Cancelable) {
+        pWrite->Cancelable = FALSE;
+        pThis->RemoveUnstagedWriteLocked(pWrite);
+    }
+
+    pThis->FreeWriteLocked(pWrite);
+
+    pThis->m_Lock.Release(irql);
+
+    _CompleteWrite(Irp, pUrb, STATUS_CANCELLED, USBD_STATUS_CANCELED, 0);
+}
+#endif
+
+VOID
+FxUsbPipeWriteCoalescer::RetireBatchesLocked(
+    __in PLIST_ENTRY CompletedWrites
+    )
+/*++
+
+Routine Description:
+    Frees completed merged transfers in send order and moves every write
+    whose last byte they carried to CompletedWrites.  A failed transfer fails
+    every write it carried any part of.
+
+  --*/
+{
+    FxUsbCoalescedWrite* pWrite;
+    FxUsbWriteBatch* pBatch;
+
+    while (m_Batches[m_Head].State == FxUsbWriteBatchDone) {
+        pBatch = &m_Batches[m_Head];
+
+        while (!IsListEmpty(&m_PendingWrites)) {
+            pWrite = CONTAINING_RECORD(m_PendingWrites.Flink,
+                                       FxUsbCoalescedWrite,
+                                       ListEntry);
+
+            if (pWrite->End > pBatch->End) {
+                //
+                // The write continues in a later transfer.  Remember the
+                // failure if this transfer carried its first part.
+                //
+                if (!NT_SUCCESS(pBatch->Status) &&
+                    NT_SUCCESS(pWrite->Status) &&
+                    pWrite->End - pWrite->Length < pBatch->End) {
+                    pWrite->Status = pBatch->Status;
+                    pWrite->UsbdStatus = pBatch->UsbdStatus;
+                }
+                break;
+            }
+
+            if (!NT_SUCCESS(pBatch->Status) && NT_SUCCESS(pWrite->Status)) {
+                pWrite->Status = pBatch->Status;
+                pWrite->UsbdStatus = pBatch->UsbdStatus;
+            }
+
+            ASSERT(m_StageEntry != &pWrite->ListEntry);
+
+            RemoveEntryList(&pWrite->ListEntry);
+            InsertTailList(CompletedWrites, &pWrite->ListEntry);
+        }
+
+        pBatch->Length = 0;
+        pBatch->State = FxUsbWriteBatchFree;
+
+        m_Head = (UCHAR) ((m_Head + 1) % m_NumBatches);
+    }
+}
+
+ULONG
+FxUsbPipeWriteCoalescer::FillBatchesLocked(
+    __out_ecount(NUM_COALESCED_WRITES_MAX) FxUsbWriteBatch** Batches
+    )
+/*++
+
+Routine Description:
+    Copies queued write data into free merged transfers, in order, and marks
+    each transfer it fills as sent.  The cancel routine of a cancelable write
+    is cleared before its first byte is copied.  If the write is being
+    canceled, it is dropped from the stream and left to the cancel routine.
+
+Arguments:
+    Batches - receives the transfers the caller must send
+
+Return Value:
+    Number of transfers returned in Batches
+
+  --*/
+{
+    FxUsbCoalescedWrite* pWrite;
+    FxUsbWriteBatch* pBatch;
+    ULONG count, length;
+    FxIrp irp;
+
+    count = 0;
+
+    while (m_StageEntry != &m_PendingWrites &&
+           m_Batches[m_Next].State == FxUsbWriteBatchFree) {
+
+        pBatch = &m_Batches[m_Next];
+
+        ASSERT(pBatch->Length == 0);
+
+        while (m_StageEntry != &m_PendingWrites &&
+               pBatch->Length < m_TransferSize) {
+
+            pWrite = CONTAINING_RECORD(m_StageEntry,
+                                       FxUsbCoalescedWrite,
+                                       ListEntry);
+
+            if (pWrite->Cancelable) {
+                pWrite->Cancelable = FALSE;
+
+                irp.SetIrp(pWrite->Irp);
+
+                if (irp.SetCancelRoutine(NULL) == NULL) {
+                    RemoveUnstagedWriteLocked(pWrite);
+                    continue;
+                }
+
+                irp.SetContext(FX_USB_COALESCED_WRITE_CONTEXT_ENTRY, NULL);
+            }
+
+            length = pWrite->Length - pWrite->Copied;
+            if (length > m_TransferSize - pBatch->Length) {
+                length = m_TransferSize - pBatch->Length;
+            }
+
+            RtlCopyMemory(WDF_PTR_ADD_OFFSET(pBatch->Buffer, pBatch->Length),
+                          WDF_PTR_ADD_OFFSET(pWrite->Buffer, pWrite->Copied),
+                          length);
+
+            pBatch->Length += length;
+            pWrite->Copied += length;
+
+            if (pWrite->Copied == pWrite->Length) {
+                m_StageEntry = m_StageEntry->Flink;
+            }
+        }
+
+        if (pBatch->Length == 0) {
+            //
+            // Every queued write was being canceled
+            //
+            break;
+        }
+
+        m_StagedOffset += pBatch->Length;
+        pBatch->End = m_StagedOffset;
+        pBatch->Status = STATUS_SUCCESS;
+        pBatch->UsbdStatus = USBD_STATUS_SUCCESS;
+        pBatch->State = FxUsbWriteBatchSent;
+
+        Batches[count++] = pBatch;
+
+        m_Next = (UCHAR) ((m_Next + 1) % m_NumBatches);
+    }
+
+    return count;
+}
+
+_Must_inspect_result_
+NTSTATUS
+FxUsbPipeWriteCoalescer::SendBatch(
+    __in FxUsbWriteBatch* Batch
+    )
+{
+    WDF_REQUEST_REUSE_PARAMS params;
+    FxRequestBuffer buf;
+    NTSTATUS status;
+    ULONG action;
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&params, 0, STATUS_NOT_SUPPORTED);
+    Batch->Request->Reuse(&params);
+
+    buf.SetBuffer(Batch->Buffer, Batch->Length);
+
+    status = m_Pipe->FormatTransferRequest(Batch->Request,
+                                           &buf,
+                                           USBD_TRANSFER_DIRECTION_OUT);
+    if (!NT_SUCCESS(status)) {
+        DoTraceLevelMessage(
+            m_Pipe->GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "WDFUSBPIPE %p could not format coalesced write, %!STATUS!",
+            m_Pipe->GetHandle(), status);
+
+        return status;
+    }
+
+    Batch->Request->SetCompletionRoutine(_FxUsbWriteBatchComplete, Batch);
+
+    //
+    // While the target is stopped the transfer is queued and sent when the
+    // target is restarted, which keeps the write stream in order.
+    //
+    action = m_Pipe->Submit(Batch->Request, NULL, 0);
+
+    if (action & SubmitSend) {
+        m_Pipe->Send(Batch->Request->GetSubmitIrp());
+    }
+    else if ((action & SubmitQueued) == 0) {
+        status = Batch->Request->GetFxIrp()->GetStatus();
+        ASSERT(!NT_SUCCESS(status));
+    }
+
+    return status;
+}
+
+VOID
+FxUsbPipeWriteCoalescer::_FxUsbWriteBatchComplete(
+    __in WDFREQUEST Request,
+    __in WDFIOTARGET Target,
+    __in PWDF_REQUEST_COMPLETION_PARAMS Params,
+    __in WDFCONTEXT Context
+    )
+{
+    FxUsbWriteBatch* pBatch;
+
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Target);
+
+    pBatch = (FxUsbWriteBatch*) Context;
+
+    pBatch->Parent->Pump(pBatch,
+                         Params->IoStatus.Status,
+                         Params->Parameters.Usb.Completion->UsbdStatus);
+}
+
+_Must_inspect_result_
+NTSTATUS
+FxUsbPipe::InitWriteCoalescer(
+    __in ULONG NumTransfers,
+    __in ULONG TransferSize
+    )
+/*++
+
+Routine Description:
+    Turns on write coalescing for a bulk or interrupt OUT pipe.  Transfers
+    formatted for the pipe are then merged into at most NumTransfers
+    transfers in flight.  Called from InitPipe, before the pipe is handed to
+    the driver, so no I/O can race with setting m_WriteCoalescer.
+
+Arguments:
+    NumTransfers - merged transfers kept in flight, 0 for the default,
+        capped at NUM_COALESCED_WRITES_MAX
+
+    TransferSize - size of a merged transfer, see
+        FxUsbPipeWriteCoalescer::Config
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    FxUsbPipeWriteCoalescer* pCoalescer;
+    NTSTATUS status;
+
+    if (!(IsType(WdfUsbPipeTypeBulk) || IsType(WdfUsbPipeTypeInterrupt)) ||
+        IsOutEndpoint() == FALSE) {
+        status = STATUS_INVALID_DEVICE_REQUEST;
+
+        DoTraceLevelMessage(
+            GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "WDFUSBPIPE %p is not a bulk or interrupt OUT pipe, %!STATUS!",
+            GetHandle(), status);
+
+        return status;
+    }
+
+    if (m_WriteCoalescer != NULL) {
+        status = STATUS_INVALID_DEVICE_STATE;
+
+        DoTraceLevelMessage(
+            GetDriverGlobals(), TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "Write coalescing already initialized on WDFUSBPIPE %p %!STATUS!",
+            GetHandle(), status);
+
+        return status;
+    }
+
+    if (NumTransfers == 0) {
+        NumTransfers = NUM_COALESCED_WRITES_DEFAULT;
+    }
+    else if (NumTransfers > NUM_COALESCED_WRITES_MAX) {
+        NumTransfers = NUM_COALESCED_WRITES_MAX;
+    }
+
+    pCoalescer = new(GetDriverGlobals(), NumTransfers)
+        FxUsbPipeWriteCoalescer(this, (UCHAR) NumTransfers);
+
+    if (pCoalescer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    status = pCoalescer->Config(TransferSize);
+
+    if (!NT_SUCCESS(status)) {
+        delete pCoalescer;
+        return status;
+    }
+
+    m_WriteCoalescer = pCoalescer;
+
+    return STATUS_SUCCESS;
+}
+
+#if (FX_CORE_MODE == FX_CORE_KERNEL_MODE)
+VOID
+FxUsbPipe::Send(
+    _In_ MdIrp Irp
+    )
+/*++
+
+Routine Description:
+    Sends a transfer irp to the pipe.  On a pipe with a write coalescer, OUT
+    transfers formatted by FormatTransferRequest, whether sent asynchronously,
+    synchronously or resent on restart, are handed to the coalescer, which
+    takes the place of the driver below the pipe and completes the irp once
+    its data has been written.  Everything else, including the coalescer's
+    own merged transfers and zero length packets, goes down as is.
+
+Arguments:
+    Irp - irp whose next stack location has been formatted for the pipe
+
+  --*/
+{
+    _URB_BULK_OR_INTERRUPT_TRANSFER* pUrb;
+    PIO_STACK_LOCATION pStack;
+    FxIrp irp(Irp);
+    PVOID pBuffer;
+
+    if (m_WriteCoalescer == NULL || m_WriteCoalescer->IsBatchIrp(Irp)) {
+        FxIoTarget::Send(Irp);
+        return;
+    }
+
+    pStack = irp.GetNextIrpStackLocation();
+
+    if (pStack->MajorFunction != IRP_MJ_INTERNAL_DEVICE_CONTROL ||
+        pStack->Parameters.DeviceIoControl.IoControlCode !=
+            IOCTL_INTERNAL_USB_SUBMIT_URB) {
+        FxIoTarget::Send(Irp);
+        return;
+    }
+
+    pUrb = (_URB_BULK_OR_INTERRUPT_TRANSFER*) pStack->Parameters.Others.Argument1;
+
+    if (pUrb->Hdr.Function != URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER ||
+        pUrb->PipeHandle != m_PipeInformation.PipeHandle ||
+        (pUrb->TransferFlags & USBD_TRANSFER_DIRECTION_IN) ||
+        pUrb->TransferBufferLength == 0) {
+        FxIoTarget::Send(Irp);
+        return;
+    }
+
+    //
+    // The data is copied at DISPATCH_LEVEL in arbitrary thread context.  A
+    // TransferBuffer without an MDL is nonpaged system memory, as the USB
+    // stack requires; an MDL is mapped.
+    //
+    if (pUrb->TransferBufferMDL == NULL) {
+        pBuffer = pUrb->TransferBuffer;
+    }
+    else if (pUrb->TransferBufferMDL->Next == NULL) {
+        pBuffer = Mx::MxGetSystemAddressForMdlSafe(pUrb->TransferBufferMDL,
+                                                   NormalPagePriority);
+    }
+    else {
+        pBuffer = NULL;
+    }
+
+    if (pBuffer == NULL) {
+        FxIoTarget::Send(Irp);
+        return;
+    }
+
+    irp.SetNextIrpStackLocation();
+    irp.MarkIrpPending();
+
+    m_WriteCoalescer->Write(Irp, pUrb, pBuffer, pUrb->TransferBufferLength);
+}
+#endif
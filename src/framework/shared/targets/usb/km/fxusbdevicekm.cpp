@@ -999,12 +999,14 @@ Return Value:
                 // do the following only if the bit is not already set
                 //
                 if (FxBitArraySet(&bitArray[0], interfaceNumber) == FALSE) {
+                    FxUsbConfigIndexSetting* pSetting;
+
+                    pSetting = FxUsbConfigIndexGetSetting(m_ConfigIndex,
+                                                          interfaceNumber,
+                                                          altSettingIndex);
+
                     pList[interfacePairsNum].InterfaceDescriptor =
-                         FxUsbParseConfigurationDescriptor(
-                             m_ConfigDescriptor,
-                             interfaceNumber,
-                             altSettingIndex
-                             );
+                        pSetting != NULL ? pSetting->InterfaceDescriptor : NULL;
 
                     if (pList[interfacePairsNum].InterfaceDescriptor == NULL) {
                         status = STATUS_INVALID_PARAMETER;
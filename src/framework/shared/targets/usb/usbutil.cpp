@@ -360,6 +360,193 @@ FxUsbParseConfigurationDescriptor(
     return found;
 }
 
+_Must_inspect_result_
+NTSTATUS
+FxUsbBuildConfigIndex(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in PUSB_CONFIGURATION_DESCRIPTOR ConfigDescriptor,
+    __deref_out FxUsbConfigIndex** Index
+    )
+/*++
+
+Routine Description:
+    Walks the config descriptor once to size the index and once more to fill
+    it in.  The interface, setting and endpoint tables are carved out of a
+    single allocation which is released with FxPoolFree.
+
+    The caller must have already validated the common descriptor headers and
+    the size of every interface descriptor.
+
+Arguments:
+    FxDriverGlobals - client driver globals
+
+    ConfigDescriptor - the entire config descriptor of the usb device
+
+    Index - receives the index on success
+
+Return Value:
+    NTSTATUS
+
+  --*/
+{
+    FxUsbConfigIndex* pIndex;
+    FxUsbConfigIndexInterface* pInterface;
+    FxUsbConfigIndexSetting* pSetting;
+    FxUsbConfigIndexSetting* pNextSetting;
+    PUSB_ENDPOINT_DESCRIPTOR* pNextEndpoint;
+    PUSB_INTERFACE_DESCRIPTOR pInterfaceDesc;
+    PUSB_COMMON_DESCRIPTOR pCommonDesc;
+    UCHAR slotMap[UCHAR_MAX + 1];
+    UCHAR settingCount[UCHAR_MAX];
+    PUCHAR pCur, pEnd;
+    ULONG numInterfaces, numSettings, numEndpoints, endpointsLeft, i;
+    size_t size;
+
+    *Index = NULL;
+
+    RtlFillMemory(slotMap, sizeof(slotMap), FX_USB_CONFIG_INDEX_NO_INTERFACE);
+    RtlZeroMemory(settingCount, sizeof(settingCount));
+
+    numInterfaces = 0;
+    numEndpoints = 0;
+    endpointsLeft = 0;
+
+    pCur = (PUCHAR) ConfigDescriptor;
+    pEnd = (PUCHAR) WDF_PTR_ADD_OFFSET(ConfigDescriptor,
+                                       ConfigDescriptor->wTotalLength);
+
+    //
+    // First pass, assign a slot to each interface number and count its
+    // settings along with the endpoints which will be indexed.
+    //
+    while (pCur < pEnd) {
+        pCommonDesc = (PUSB_COMMON_DESCRIPTOR) pCur;
+
+        if (pCommonDesc->bDescriptorType == USB_INTERFACE_DESCRIPTOR_TYPE) {
+            pInterfaceDesc = (PUSB_INTERFACE_DESCRIPTOR) pCommonDesc;
+            endpointsLeft = 0;
+
+            if (slotMap[pInterfaceDesc->bInterfaceNumber] ==
+                                            FX_USB_CONFIG_INDEX_NO_INTERFACE &&
+                numInterfaces < FX_USB_CONFIG_INDEX_NO_INTERFACE) {
+                slotMap[pInterfaceDesc->bInterfaceNumber] = (UCHAR) numInterfaces;
+                numInterfaces++;
+            }
+
+            if (slotMap[pInterfaceDesc->bInterfaceNumber] !=
+                                            FX_USB_CONFIG_INDEX_NO_INTERFACE) {
+                if (settingCount[slotMap[pInterfaceDesc->bInterfaceNumber]] < UCHAR_MAX) {
+                    settingCount[slotMap[pInterfaceDesc->bInterfaceNumber]]++;
+                }
+
+                //
+                // Reserve room for the endpoints of every descriptor, even
+                // duplicates, since the second pass captures each of them.
+                //
+                endpointsLeft = pInterfaceDesc->bNumEndpoints;
+            }
+        }
+        else if (pCommonDesc->bDescriptorType == USB_ENDPOINT_DESCRIPTOR_TYPE &&
+                 endpointsLeft > 0) {
+            numEndpoints++;
+            endpointsLeft--;
+        }
+
+        pCur += pCommonDesc->bLength;
+    }
+
+    numSettings = 0;
+    for (i = 0; i < numInterfaces; i++) {
+        numSettings += settingCount[i];
+    }
+
+    size = sizeof(FxUsbConfigIndex) +
+           numInterfaces * sizeof(FxUsbConfigIndexInterface) +
+           numSettings * sizeof(FxUsbConfigIndexSetting) +
+           numEndpoints * sizeof(PUSB_ENDPOINT_DESCRIPTOR);
+
+    pIndex = (FxUsbConfigIndex*) FxPoolAllocate(FxDriverGlobals,
+                                                NonPagedPool,
+                                                size);
+    if (pIndex == NULL) {
+        DoTraceLevelMessage(
+            FxDriverGlobals, TRACE_LEVEL_ERROR, TRACINGIOTARGET,
+            "Could not allocate config descriptor index for %d interfaces, "
+            "%d settings, %d endpoints, %!STATUS!",
+            numInterfaces, numSettings, numEndpoints,
+            STATUS_INSUFFICIENT_RESOURCES);
+
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(pIndex, size);
+    RtlCopyMemory(pIndex->InterfaceSlot, slotMap, sizeof(slotMap));
+
+    pIndex->NumInterfaces = numInterfaces;
+    pIndex->Interfaces = (FxUsbConfigIndexInterface*) (pIndex + 1);
+
+    pNextSetting = (FxUsbConfigIndexSetting*)
+        (pIndex->Interfaces + numInterfaces);
+    pNextEndpoint = (PUSB_ENDPOINT_DESCRIPTOR*) (pNextSetting + numSettings);
+
+    for (i = 0; i < numInterfaces; i++) {
+        pIndex->Interfaces[i].Settings = pNextSetting;
+        pIndex->Interfaces[i].NumSettings = settingCount[i];
+        pNextSetting += settingCount[i];
+    }
+
+    //
+    // Second pass, record each setting under its alternate setting number
+    // and capture its endpoints.  A later duplicate of an alternate setting
+    // replaces the earlier one.
+    //
+    pSetting = NULL;
+    pCur = (PUCHAR) ConfigDescriptor;
+
+    while (pCur < pEnd) {
+        pCommonDesc = (PUSB_COMMON_DESCRIPTOR) pCur;
+
+        if (pCommonDesc->bDescriptorType == USB_INTERFACE_DESCRIPTOR_TYPE) {
+            pInterfaceDesc = (PUSB_INTERFACE_DESCRIPTOR) pCommonDesc;
+            pSetting = NULL;
+
+            pInterface = FxUsbConfigIndexGetInterface(
+                pIndex, pInterfaceDesc->bInterfaceNumber);
+
+            if (pInterface != NULL) {
+                if (pInterface->FirstDescriptor == NULL) {
+                    pInterface->FirstDescriptor = pInterfaceDesc;
+                }
+
+                if (pInterfaceDesc->bAlternateSetting < pInterface->NumSettings) {
+                    pSetting = &pInterface->Settings[pInterfaceDesc->bAlternateSetting];
+                    pSetting->InterfaceDescriptor = pInterfaceDesc;
+                    pSetting->Endpoints = pNextEndpoint;
+                    pSetting->NumEndpoints = 0;
+                }
+            }
+        }
+        else if (pCommonDesc->bDescriptorType == USB_ENDPOINT_DESCRIPTOR_TYPE &&
+                 pSetting != NULL &&
+                 pSetting->NumEndpoints <
+                                pSetting->InterfaceDescriptor->bNumEndpoints) {
+            ASSERT(pNextEndpoint <
+                   (PUSB_ENDPOINT_DESCRIPTOR*) WDF_PTR_ADD_OFFSET(pIndex, size));
+
+            pSetting->Endpoints[pSetting->NumEndpoints] =
+                (PUSB_ENDPOINT_DESCRIPTOR) pCommonDesc;
+            pSetting->NumEndpoints++;
+            pNextEndpoint++;
+        }
+
+        pCur += pCommonDesc->bLength;
+    }
+
+    *Index = pIndex;
+
+    return STATUS_SUCCESS;
+}
+
 PURB
 FxUsbCreateConfigRequest(
     __in PFX_DRIVER_GLOBALS FxDriverGlobals,
@@ -140,6 +140,111 @@ FxUsbValidateDescriptorType(
     __in ULONG MaximumNumDescriptorsToValidate
     );
 
+//
+// Flattened view of a validated config descriptor, built once when the
+// descriptor is retrieved so that selecting a configuration or setting and
+// querying endpoints do not rewalk the raw descriptor.  Every table lives in
+// the same allocation as the FxUsbConfigIndex header and points back into the
+// config descriptor, which must outlive the index.
+//
+// What this saves is the time to select a configuration or setting on a
+// device with many interfaces and alternate settings, e.g. a composite audio
+// or video function, timed around WdfUsbTargetDeviceSelectConfig and
+// WdfUsbInterfaceSelectSetting.
+//
+struct FxUsbConfigIndexSetting {
+    PUSB_INTERFACE_DESCRIPTOR InterfaceDescriptor;
+
+    //
+    // The first bNumEndpoints endpoint descriptors which follow the interface
+    // descriptor, NumEndpoints can be smaller if the device reports more
+    // endpoints than it describes.
+    //
+    PUSB_ENDPOINT_DESCRIPTOR* Endpoints;
+
+    UCHAR NumEndpoints;
+};
+
+struct FxUsbConfigIndexInterface {
+    //
+    // First interface descriptor found for this interface number
+    //
+    PUSB_INTERFACE_DESCRIPTOR FirstDescriptor;
+
+    //
+    // Indexed by bAlternateSetting.  A setting whose alternate setting number
+    // is out of range is not recorded, leaving its InterfaceDescriptor NULL.
+    //
+    FxUsbConfigIndexSetting* Settings;
+
+    UCHAR NumSettings;
+};
+
+#define FX_USB_CONFIG_INDEX_NO_INTERFACE (0xFF)
+
+struct FxUsbConfigIndex {
+    //
+    // Interfaces in the order their first descriptor appears in the config
+    // descriptor
+    //
+    FxUsbConfigIndexInterface* Interfaces;
+
+    ULONG NumInterfaces;
+
+    //
+    // Maps bInterfaceNumber to its slot in Interfaces, or
+    // FX_USB_CONFIG_INDEX_NO_INTERFACE
+    //
+    UCHAR InterfaceSlot[UCHAR_MAX + 1];
+};
+
+_Must_inspect_result_
+NTSTATUS
+FxUsbBuildConfigIndex(
+    __in PFX_DRIVER_GLOBALS FxDriverGlobals,
+    __in PUSB_CONFIGURATION_DESCRIPTOR ConfigDescriptor,
+    __deref_out FxUsbConfigIndex** Index
+    );
+
+FORCEINLINE
+FxUsbConfigIndexInterface*
+FxUsbConfigIndexGetInterface(
+    __in FxUsbConfigIndex* Index,
+    __in UCHAR InterfaceNumber
+    )
+{
+    UCHAR slot;
+
+    slot = Index->InterfaceSlot[InterfaceNumber];
+
+    if (slot == FX_USB_CONFIG_INDEX_NO_INTERFACE) {
+        return NULL;
+    }
+
+    return &Index->Interfaces[slot];
+}
+
+FORCEINLINE
+FxUsbConfigIndexSetting*
+FxUsbConfigIndexGetSetting(
+    __in FxUsbConfigIndex* Index,
+    __in UCHAR InterfaceNumber,
+    __in UCHAR AlternateSetting
+    )
+{
+    FxUsbConfigIndexInterface* pInterface;
+
+    pInterface = FxUsbConfigIndexGetInterface(Index, InterfaceNumber);
+
+    if (pInterface == NULL ||
+        AlternateSetting >= pInterface->NumSettings ||
+        pInterface->Settings[AlternateSetting].InterfaceDescriptor == NULL) {
+        return NULL;
+    }
+
+    return &pInterface->Settings[AlternateSetting];
+}
+
 #if (FX_CORE_MODE == FX_CORE_USER_MODE)
 VOID
 FxUsbUmFormatRequest(